@@ -8,21 +8,72 @@
 #include "ResultSaver.h"
 #include "Inference.h"
 #include "FrameResult.h"
+#include "LatencyMonitor.h"
 
 using namespace std;
 using namespace cv;
 
+// Reads a video, runs detection on it and writes output.avi:
+//   YOLOv8DetOOP [video] [--budget ms] [--p99 ms] [--decode-threads n] [--keyframes]
+//   --budget          live-latency mode: the file is read at its real frame
+//                     rate and frames that wait longer than the budget are
+//                     dropped before inference
+//   --p99             p99 latency target; hands model choice, input size and
+//                     sampling rate to an SloController (read in real time too)
+//   --decode-threads  splits the file into chunks decoded in parallel and
+//                     queued back in file order
+//   --keyframes       triage mode that decodes and analyses only the
+//                     keyframes of the file (needs YOLOV8_WITH_FFMPEG)
 int main(int argc, char** argv) {
     namespace fs = std::filesystem;
     fs::path current_path = fs::current_path();
-    std::string videoFilePath = (argc == 2) ? argv[1] : current_path.string()+"/1.mp4";
-    std::cout << "videoFilePath " << videoFilePath << std::endl;
+    std::string videoFilePath = current_path.string()+"/1.mp4";
     int framesPerSecond = 1;
+    double latencyBudgetMs = 0.0;
+    double targetP99Ms = 0.0;
+    int decodeThreads = 1;
+    bool keyframesOnly = false;
+    LatencyMonitor latencyMonitor;
+
+    const std::string usage = "Usage: YOLOv8DetOOP [video] [--budget ms] [--p99 ms] [--decode-threads n] [--keyframes]";
+    bool videoGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        try {
+            if (argument == "--budget" && hasValue) {
+                latencyBudgetMs = std::stod(argv[++i]);
+            } else if (argument == "--p99" && hasValue) {
+                targetP99Ms = std::stod(argv[++i]);
+            } else if (argument == "--decode-threads" && hasValue) {
+                decodeThreads = std::stoi(argv[++i]);
+            } else if (argument == "--keyframes") {
+                keyframesOnly = true;
+            } else if (argument.rfind("--", 0) != 0 && !videoGiven) {
+                videoFilePath = argument;
+                videoGiven = true;
+            } else {
+                std::cerr << "Error: unexpected argument " << argument << "\n" << usage << std::endl;
+                return -1;
+            }
+        } catch (const std::logic_error&) {
+            std::cerr << "Error: bad value for " << argument << "\n" << usage << std::endl;
+            return -1;
+        }
+    }
+    std::cout << "videoFilePath " << videoFilePath << std::endl;
 
-    ThreadSafeQueue<cv::Mat> frameQueue;
+    ThreadSafeQueue<TimedFrame> frameQueue;
     ThreadSafeQueue<FrameResult> resultQueue;
 
-    std::thread videoThread(VideoReader(videoFilePath, frameQueue, framesPerSecond));
+    VideoReader reader(videoFilePath, frameQueue, framesPerSecond);
+    // Both modes measure latency from capture, which only means something
+    // if frames arrive at the file's real rate rather than as fast as they
+    // decode.
+    reader.setRealTime(latencyBudgetMs > 0.0 || targetP99Ms > 0.0);
+    reader.setSegments(decodeThreads);
+    reader.setKeyframesOnly(keyframesOnly);
+    std::thread videoThread(reader);
 
     cv::VideoCapture cap(videoFilePath);
     if (!cap.isOpened()) {
@@ -41,14 +92,34 @@ int main(int argc, char** argv) {
 
     Inference inf(projectBasePath + "/yolov8s.onnx", cv::Size(640, 640), "classes.txt", runOnGPU);
 
-    std::thread processThread(FrameProcessor(frameQueue, resultQueue, inf));
+    FrameProcessor processor(frameQueue, resultQueue, inf);
+    if (latencyBudgetMs > 0.0) {
+        processor.enableLatencyMode(latencyBudgetMs, latencyMonitor);
+    }
+
+    std::unique_ptr<SloController> controller;
+    if (targetP99Ms > 0.0) {
+        SloController::Options options;
+        options.targetP99Ms = targetP99Ms;
+        options.modelTiers = { projectBasePath + "/yolov8s.onnx", projectBasePath + "/yolov8n.onnx" };
+        controller = std::make_unique<SloController>(options, [runOnGPU](const std::string& modelPath, const cv::Size& shape) {
+            return std::make_unique<Inference>(modelPath, shape, "classes.txt", runOnGPU);
+        });
+        processor.setController(*controller);
+    }
+    std::thread processThread(processor);
 
     std::string outputFilePath = "output.avi";
-    std::thread saveThread(ResultSaver(resultQueue, outputFilePath, fps, frameSize));
+    ResultSaver saver(resultQueue, outputFilePath, fps, frameSize);
+    saver.setLatencyMonitor(latencyMonitor);
+    std::thread saveThread(saver);
 
     videoThread.join();
     processThread.join();
     saveThread.join();
 
+    latencyMonitor.print(std::cout);
+    inf.getStartupStats().print(std::cout);
+
     return 0;
 }
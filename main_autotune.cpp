@@ -0,0 +1,318 @@
+// Author: shaoshengsong
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "inference.h"
+
+using namespace std;
+using namespace cv;
+
+// Offline sweep over the knobs that decide throughput on this machine:
+// replicas (independent Inference objects on their own threads), intra-op
+// threads per replica, batch size and network input size. Each setting is run
+// over the same frames; the ones no other setting beats on throughput, p95
+// latency and agreement with the reference setting at once are written out.
+//
+//   YOLOv8DetAutoTune [model] [video or image] [output.yml] [frames per trial] [backend]
+//
+// Without an input (or if it cannot be read) synthetic frames are used; they
+// measure speed only, since there is nothing in them to agree on.
+
+struct TuneConfig {
+    int replicas{1};
+    int threads{1};
+    int batch{1};
+    int size{640};
+};
+
+struct TuneResult {
+    TuneConfig config;
+    double fps{0.0};
+    double p50Ms{0.0};
+    double p95Ms{0.0};
+    double agreement{1.0}; // F1 against the reference setting
+    bool pareto{false};
+};
+
+using FrameDetections = std::vector<std::vector<CompactDetection>>;
+
+std::vector<cv::Mat> loadTuneFrames(const std::string& inputPath, size_t count) {
+    std::vector<cv::Mat> frames;
+    if (!inputPath.empty()) {
+        cv::Mat image = cv::imread(inputPath);
+        if (!image.empty()) {
+            frames.push_back(image);
+        } else {
+            cv::VideoCapture cap(inputPath);
+            // Spread the samples over the clip rather than taking its first second.
+            int total = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+            int step = total > static_cast<int>(count) ? total / static_cast<int>(count) : 1;
+            cv::Mat frame;
+            for (int index = 0; frames.size() < count && cap.read(frame); ++index) {
+                if (index % step == 0) {
+                    frames.push_back(frame.clone());
+                }
+            }
+        }
+    }
+    if (frames.empty()) {
+        std::cout << "Using synthetic 1280x720 frames; agreement will not be meaningful." << std::endl;
+        for (size_t i = 0; i < count; ++i) {
+            cv::Mat frame(720, 1280, CV_8UC3);
+            cv::randu(frame, cv::Scalar(0, 0, 0), cv::Scalar(255, 255, 255));
+            frames.push_back(frame);
+        }
+    }
+    return frames;
+}
+
+// Detection-level F1 of `candidate` against `reference`: boxes match greedily
+// when they share a class and overlap by at least minIou.
+double detectionAgreement(const FrameDetections& reference, const FrameDetections& candidate, float minIou = 0.5f) {
+    long matched = 0;
+    long referenceCount = 0;
+    long candidateCount = 0;
+    for (size_t f = 0; f < reference.size() && f < candidate.size(); ++f) {
+        std::vector<bool> taken(reference[f].size(), false);
+        for (const CompactDetection& c : candidate[f]) {
+            cv::Rect cBox(c.x, c.y, c.width, c.height);
+            int best = -1;
+            float bestIou = minIou;
+            for (size_t r = 0; r < reference[f].size(); ++r) {
+                const CompactDetection& ref = reference[f][r];
+                if (taken[r] || ref.classId != c.classId) {
+                    continue;
+                }
+                cv::Rect rBox(ref.x, ref.y, ref.width, ref.height);
+                float overlap = static_cast<float>((cBox & rBox).area());
+                float iou = overlap / (cBox.area() + rBox.area() - overlap);
+                if (iou >= bestIou) {
+                    bestIou = iou;
+                    best = static_cast<int>(r);
+                }
+            }
+            if (best >= 0) {
+                taken[best] = true;
+                matched++;
+            }
+        }
+        referenceCount += reference[f].size();
+        candidateCount += candidate[f].size();
+    }
+    long total = referenceCount + candidateCount;
+    return total ? 2.0 * matched / total : 1.0;
+}
+
+// Runs one setting: an untimed pass over every frame on the first replica
+// (warm-up, and the detections used for agreement), then trialFrames frames
+// shared out to all replicas. A batch's latency is charged to each of its frames.
+TuneResult runTrial(const std::string& modelPath, const BackendOptions& backend, const TuneConfig& config,
+                    const std::vector<cv::Mat>& frames, int trialFrames, FrameDetections& detections) {
+    BackendOptions options = backend;
+    if (options.type == BackendType::OpenCVDnn) {
+        cv::setNumThreads(config.threads);
+    } else {
+        options.intraOpThreads = config.threads;
+    }
+
+    std::vector<std::unique_ptr<Inference>> replicas;
+    for (int i = 0; i < config.replicas; ++i) {
+        replicas.push_back(std::make_unique<Inference>(modelPath, cv::Size(config.size, config.size), "classes.txt", false, options));
+    }
+
+    auto batchAt = [&frames, &config](size_t first) {
+        std::vector<cv::Mat> batch;
+        for (int j = 0; j < config.batch; ++j) {
+            batch.push_back(frames[(first + j) % frames.size()]);
+        }
+        return batch;
+    };
+
+    detections.assign(frames.size(), {});
+    FrameDetections results;
+    for (size_t first = 0; first < frames.size(); first += config.batch) {
+        replicas[0]->runInference(batchAt(first), results);
+        for (size_t j = 0; j < results.size() && first + j < frames.size(); ++j) {
+            detections[first + j] = results[j];
+        }
+    }
+    for (size_t i = 1; i < replicas.size(); ++i) {
+        replicas[i]->runInference(batchAt(0), results);
+    }
+
+    const int batches = std::max(1, trialFrames / config.batch);
+    std::atomic<int> next{0};
+    std::mutex mutex;
+    std::vector<double> latencies;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (std::unique_ptr<Inference>& replica : replicas) {
+        threads.emplace_back([&, inf = replica.get()] {
+            FrameDetections local;
+            std::vector<double> own;
+            for (int k = next++; k < batches; k = next++) {
+                std::vector<cv::Mat> batch = batchAt(static_cast<size_t>(k) * config.batch);
+                auto begin = std::chrono::steady_clock::now();
+                inf->runInference(batch, local);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+                own.insert(own.end(), batch.size(), ms);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            latencies.insert(latencies.end(), own.begin(), own.end());
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    TuneResult result;
+    result.config = config;
+    result.fps = latencies.size() / seconds;
+    result.p50Ms = latencies[latencies.size() / 2];
+    result.p95Ms = latencies[std::min(latencies.size() - 1, latencies.size() * 95 / 100)];
+    return result;
+}
+
+bool dominates(const TuneResult& a, const TuneResult& b) {
+    bool noWorse = a.fps >= b.fps && a.p95Ms <= b.p95Ms && a.agreement >= b.agreement;
+    bool better = a.fps > b.fps || a.p95Ms < b.p95Ms || a.agreement > b.agreement;
+    return noWorse && better;
+}
+
+// Writes the Pareto set, plus a YOLOv8DetPipeline stage graph for the fastest
+// Pareto setting the pipeline can express (it runs one frame at a time).
+void writeTuneResults(const std::string& outputPath, const std::vector<TuneResult>& results, const std::string& modelPath,
+                      const std::string& inputPath, const BackendOptions& backend) {
+    cv::FileStorage fs(outputPath, cv::FileStorage::WRITE);
+    if (!fs.isOpened()) {
+        throw std::runtime_error("Could not write " + outputPath);
+    }
+
+    const TuneResult* best = nullptr;
+    fs << "pareto" << "[";
+    for (const TuneResult& result : results) {
+        if (!result.pareto) {
+            continue;
+        }
+        fs << "{:" << "replicas" << result.config.replicas << "threads" << result.config.threads
+           << "batch" << result.config.batch << "size" << result.config.size
+           << "fps" << result.fps << "p50Ms" << result.p50Ms << "p95Ms" << result.p95Ms
+           << "agreement" << result.agreement << "}";
+        if (result.config.batch == 1 && (!best || result.fps > best->fps)) {
+            best = &result;
+        }
+    }
+    fs << "]";
+
+    if (!best) {
+        return;
+    }
+    bool opencv = backend.type == BackendType::OpenCVDnn;
+    fs << "queueCapacity" << 8;
+    fs << "layout" << "auto";
+    if (opencv) {
+        fs << "opencvThreads" << best->config.threads;
+    }
+    fs << "stages" << "[";
+    fs << "{:" << "name" << "decode" << "kind" << "decode" << "source" << (inputPath.empty() ? "1.mp4" : inputPath) << "}";
+    fs << "{:" << "name" << "infer" << "kind" << "infer" << "replicas" << best->config.replicas
+       << "model" << modelPath << "classes" << "classes.txt"
+       << "width" << best->config.size << "height" << best->config.size
+       << "backend" << backendTypeName(backend.type) << "threads" << (opencv ? 0 : best->config.threads)
+       << "cuda" << 0 << "}";
+    fs << "{:" << "name" << "sink" << "kind" << "sink" << "}";
+    fs << "]";
+}
+
+int main(int argc, char** argv) {
+    namespace fs = std::filesystem;
+    fs::path current_path = fs::current_path();
+    std::string modelPath = (argc > 1) ? argv[1] : current_path.string() + "/ultralytics/yolov8s.onnx";
+    std::string inputPath = (argc > 2) ? argv[2] : "";
+    std::string outputPath = (argc > 3) ? argv[3] : "autotune.yml";
+    int trialFrames = (argc > 4) ? std::max(1, std::stoi(argv[4])) : 64;
+
+    BackendOptions backend;
+    backend.type = backendTypeFromName((argc > 5) ? argv[5] : "opencv");
+
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> threadCounts = {1, 2, 4, cores};
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    // The first setting is the reference the others are compared against.
+    std::vector<TuneConfig> configs = {{1, cores, 1, 640}};
+    for (int size : {640, 480, 320}) {
+        for (int batch : {1, 2, 4}) {
+            for (int replicas : {1, 2, 4}) {
+                for (int threads : threadCounts) {
+                    if (replicas * threads > cores && !(replicas == 1 && threads == 1)) {
+                        continue;
+                    }
+                    if (replicas == 1 && threads == cores && batch == 1 && size == 640) {
+                        continue;
+                    }
+                    configs.push_back({replicas, threads, batch, size});
+                }
+            }
+        }
+    }
+
+    std::vector<cv::Mat> frames = loadTuneFrames(inputPath, 32);
+    std::cout << configs.size() << " settings, " << frames.size() << " frames, "
+              << trialFrames << " frames per trial on " << cores << " cores" << std::endl;
+
+    std::vector<TuneResult> results;
+    FrameDetections reference;
+    for (const TuneConfig& config : configs) {
+        FrameDetections detections;
+        try {
+            TuneResult result = runTrial(modelPath, backend, config, frames, trialFrames, detections);
+            if (results.empty()) {
+                reference = detections;
+            }
+            result.agreement = detectionAgreement(reference, detections);
+            results.push_back(result);
+        } catch (const std::exception& e) {
+            if (results.empty()) {
+                std::cerr << "Error: reference setting failed: " << e.what() << std::endl;
+                return 1;
+            }
+            std::cout << cv::format("skip r%d t%d b%d %d: ", config.replicas, config.threads, config.batch, config.size)
+                      << e.what() << std::endl;
+        }
+    }
+
+    for (TuneResult& result : results) {
+        result.pareto = std::none_of(results.begin(), results.end(),
+                                     [&result](const TuneResult& other) { return dominates(other, result); });
+    }
+
+    std::cout << "\nreplicas threads batch size      fps   p50(ms)   p95(ms) agreement" << std::endl;
+    for (const TuneResult& result : results) {
+        std::cout << cv::format("%8d %7d %5d %4d %8.1f %9.2f %9.2f %9.3f %s",
+                                result.config.replicas, result.config.threads, result.config.batch, result.config.size,
+                                result.fps, result.p50Ms, result.p95Ms, result.agreement,
+                                result.pareto ? "*" : "") << std::endl;
+    }
+
+    try {
+        writeTuneResults(outputPath, results, modelPath, inputPath, backend);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "\nPareto settings (*) written to " << outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,258 @@
+// Author: shaoshengsong
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include "eigen_engine.h"
+#include "inference.h"
+#include "yuv_preprocess.h"
+#include "ProcessMemory.h"
+
+using namespace std;
+using namespace cv;
+
+struct BenchmarkResult {
+    std::string backend;
+    double meanMs{0.0};
+    double p50Ms{0.0};
+    double p95Ms{0.0};
+    size_t detections{0};
+};
+
+// Frame used for every run: an image, the first frame of a video, or a synthetic frame.
+cv::Mat loadBenchmarkFrame(const std::string& inputPath) {
+    cv::Mat frame;
+    if (!inputPath.empty()) {
+        frame = cv::imread(inputPath);
+        if (frame.empty()) {
+            cv::VideoCapture cap(inputPath);
+            if (cap.isOpened()) {
+                cap >> frame;
+            }
+        }
+    }
+    if (frame.empty()) {
+        std::cout << "Using a synthetic 1280x720 frame." << std::endl;
+        frame = cv::Mat(720, 1280, CV_8UC3);
+        cv::randu(frame, cv::Scalar(0, 0, 0), cv::Scalar(255, 255, 255));
+    }
+    return frame;
+}
+
+BenchmarkResult runBenchmark(Inference& inf, const cv::Mat& frame, int iterations) {
+    for (int i = 0; i < 5; ++i) {
+        inf.runInference(frame);
+    }
+
+    std::vector<double> latencies;
+    size_t detections = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        detections = inf.runInference(frame).size();
+        auto end = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    BenchmarkResult result;
+    result.backend = inf.backendName();
+    for (double latency : latencies) {
+        result.meanMs += latency;
+    }
+    result.meanMs /= latencies.size();
+    result.p50Ms = latencies[latencies.size() / 2];
+    result.p95Ms = latencies[std::min(latencies.size() - 1, latencies.size() * 95 / 100)];
+    result.detections = detections;
+    return result;
+}
+
+// Runs the cascade over the frames of a video (or the single benchmark frame)
+// and reports how often it escalated and what each tier cost.
+void runCascadeBenchmark(Inference& inf, const std::string& inputPath, const cv::Mat& fallbackFrame, int iterations) {
+    cv::VideoCapture cap;
+    if (!inputPath.empty()) {
+        cap.open(inputPath);
+    }
+
+    for (int i = 0; i < iterations; ++i) {
+        cv::Mat frame;
+        if (cap.isOpened()) {
+            cap >> frame;
+        }
+        inf.runInference(frame.empty() ? fallbackFrame : frame);
+    }
+
+    CascadeStats stats = inf.getCascadeStats();
+    std::cout << "\ncascade frames " << stats.frames
+              << ", escalated " << stats.escalations
+              << " (" << cv::format("%.1f", stats.escalationRate() * 100.0) << "%)" << std::endl;
+    std::cout << cv::format("primary   mean %.2f ms, max %.2f ms", stats.primaryMsMean(), stats.primaryMsMax) << std::endl;
+    std::cout << cv::format("escalated mean %.2f ms, max %.2f ms", stats.escalatedMsMean(), stats.escalatedMsMax) << std::endl;
+}
+
+// Compares the two ways a decoded NV12 frame can become a 640x640 network blob:
+// converting to BGR first (what cv::VideoCapture plus Inference do) against
+// yuvToBlob reading the planes directly.
+void runPreprocessBenchmark(const cv::Mat& frame, int iterations) {
+    // 4:2:0 needs even dimensions.
+    cv::Mat bgr = frame(cv::Rect(0, 0, frame.cols & ~1, frame.rows & ~1)).clone();
+    cv::Mat i420;
+    cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+
+    // Same picture as NV12: the Y plane followed by interleaved U/V.
+    const int width = bgr.cols;
+    const int height = bgr.rows;
+    cv::Mat nv12(height * 3 / 2, width, CV_8UC1);
+    i420.rowRange(0, height).copyTo(nv12.rowRange(0, height));
+    const uint8_t* u = i420.ptr<uint8_t>(height);
+    const uint8_t* v = u + (width / 2) * (height / 2);
+    uint8_t* uv = nv12.ptr<uint8_t>(height);
+    for (int i = 0; i < (width / 2) * (height / 2); ++i) {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+
+    YuvImage image;
+    image.layout = YuvLayout::NV12;
+    image.width = width;
+    image.height = height;
+    image.y = nv12.ptr<uint8_t>();
+    image.yStride = width;
+    image.u = nv12.ptr<uint8_t>(height);
+    image.uStride = width;
+
+    const cv::Size modelSize(640, 640);
+    cv::Mat bgrBlob;
+    cv::Mat yuvBlob;
+    auto timeMs = [iterations](const std::function<void()>& step) {
+        step();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            step();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+
+    double bgrMs = timeMs([&] {
+        cv::Mat converted;
+        cv::cvtColor(nv12, converted, cv::COLOR_YUV2BGR_NV12);
+        int side = std::max(width, height);
+        cv::Mat square = cv::Mat::zeros(side, side, CV_8UC3);
+        converted.copyTo(square(cv::Rect(0, 0, width, height)));
+        cv::dnn::blobFromImage(square, bgrBlob, 1.0 / 255.0, modelSize, cv::Scalar(), true, false);
+    });
+    double yuvMs = timeMs([&] {
+        yuvToBlob(image, modelSize, true, yuvBlob);
+    });
+
+    // The paths upsample chroma and round differently, so compare on average.
+    double meanDifference = cv::norm(bgrBlob, yuvBlob, cv::NORM_L1) / bgrBlob.total();
+
+    std::cout << "\npreprocess " << width << "x" << height << " NV12 -> 640x640 blob" << std::endl;
+    std::cout << cv::format("via BGR   %8.2f ms", bgrMs) << std::endl;
+    std::cout << cv::format("yuvToBlob %8.2f ms (%.1fx), mean difference %.4f", yuvMs, bgrMs / yuvMs, meanDifference) << std::endl;
+}
+
+// Measures what a network costs in memory: unique memory of the process
+// after the first Inference, then per replica made with createReplica(). Each
+// is warmed up first, since packed weights and buffers appear on the first
+// forward. Replicas share the weights where the backend allows it, so on those
+// the per-replica figure is little more than activations; for the Eigen engine
+// the size of the one shared weights copy is shown next to it.
+void runReplicaMemoryBenchmark(const std::string& modelPath, const BackendOptions& options, int replicas) {
+    ProcessMemory before;
+    if (!readProcessMemory(0, before)) {
+        std::cout << "Skipping replica memory: /proc is not available." << std::endl;
+        return;
+    }
+
+    Inference first(modelPath, cv::Size(640, 640), "classes.txt", false, options);
+    first.warmup();
+    ProcessMemory loaded;
+    readProcessMemory(0, loaded);
+
+    std::vector<std::unique_ptr<Inference>> copies;
+    for (int i = 0; i < replicas; ++i) {
+        copies.push_back(first.createReplica());
+        copies.back()->warmup();
+    }
+    ProcessMemory replicated;
+    readProcessMemory(0, replicated);
+
+    double firstMb = (loaded.ussKb - before.ussKb) / 1024.0;
+    double replicaMb = (replicated.ussKb - loaded.ussKb) / 1024.0 / replicas;
+    std::string sharedMb = "-";
+    if (options.type == BackendType::EigenTensor) {
+        // Returns the copy the engines above hold rather than loading another.
+        std::string weightsPath = options.weightsPath.empty()
+            ? modelPath.substr(0, modelPath.find_last_of('.')) + ".y8w" : options.weightsPath;
+        sharedMb = cv::format("%.1f", EigenWeights::load(weightsPath)->byteSize() / 1024.0 / 1024.0);
+    }
+    std::cout << cv::format("%-16s %10.1f %12.1f %11s", first.backendName().c_str(), firstMb, replicaMb, sharedMb.c_str()) << std::endl;
+}
+
+int main(int argc, char** argv) {
+    namespace fs = std::filesystem;
+    fs::path current_path = fs::current_path();
+    std::string modelPath = (argc > 1) ? argv[1] : current_path.string() + "/ultralytics/yolov8s.onnx";
+    std::string inputPath = (argc > 2) ? argv[2] : "";
+    int iterations = (argc > 3) ? std::max(1, std::stoi(argv[3])) : 50;
+
+    BackendOptions ortOptions;
+    ortOptions.type = BackendType::OnnxRuntime;
+    ortOptions.intraOpThreads = (argc > 4) ? std::stoi(argv[4]) : 0;
+    ortOptions.interOpThreads = (argc > 5) ? std::stoi(argv[5]) : 1;
+    std::string cascadeModelPath = (argc > 6) ? argv[6] : "";
+
+    BackendOptions eigenOptions;
+    eigenOptions.type = BackendType::EigenTensor;
+    eigenOptions.intraOpThreads = ortOptions.intraOpThreads;
+
+    std::vector<BackendOptions> candidates = { BackendOptions{}, ortOptions, eigenOptions };
+
+    cv::Mat frame = loadBenchmarkFrame(inputPath);
+
+    std::vector<BenchmarkResult> results;
+    std::vector<BackendOptions> measured;
+    for (const BackendOptions& options : candidates) {
+        if (!isBackendAvailable(options.type)) {
+            std::cout << "Skipping " << backendTypeName(options.type) << ": not compiled in." << std::endl;
+            continue;
+        }
+        if (options.type == BackendType::EigenTensor
+            && !fs::exists(modelPath.substr(0, modelPath.find_last_of('.')) + ".y8w")) {
+            std::cout << "Skipping eigen: run tools/export_weights.py on the model first." << std::endl;
+            continue;
+        }
+        Inference inf(modelPath, cv::Size(640, 640), "classes.txt", false, options);
+        results.push_back(runBenchmark(inf, frame, iterations));
+        measured.push_back(options);
+    }
+
+    std::cout << "\nbackend            mean(ms)   p50(ms)   p95(ms)      fps  detections" << std::endl;
+    for (const BenchmarkResult& result : results) {
+        std::cout << cv::format("%-16s %10.2f %9.2f %9.2f %8.1f %11d",
+                                result.backend.c_str(), result.meanMs, result.p50Ms, result.p95Ms,
+                                1000.0 / result.meanMs, (int)result.detections) << std::endl;
+    }
+
+    runPreprocessBenchmark(frame, iterations);
+
+    std::cout << "\nbackend          first(MB)  replica(MB)  shared(MB)" << std::endl;
+    for (const BackendOptions& options : measured) {
+        runReplicaMemoryBenchmark(modelPath, options, 3);
+    }
+
+    if (!cascadeModelPath.empty()) {
+        Inference cascade(modelPath, cv::Size(640, 640), "classes.txt", false);
+        cascade.enableCascade(cascadeModelPath);
+        runCascadeBenchmark(cascade, inputPath, frame, iterations);
+    }
+
+    return 0;
+}
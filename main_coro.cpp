@@ -0,0 +1,99 @@
+// Author: shaoshengsong
+#include <iostream>
+#include <deque>
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+#include "FrameQueue.h"
+#include "VideoReader.h"
+#include "FrameProcessor.h"
+#include "ResultSaver.h"
+#include "inference.h"
+#include "FrameResult.h"
+#include "executor.h"
+
+using namespace std;
+using namespace cv;
+
+// One reader -> processor -> saver chain per input video.
+struct StreamPipeline {
+    ThreadSafeQueue<TimedFrame> frameQueue;
+    ThreadSafeQueue<FrameResult> resultQueue;
+    VideoReader reader;
+    FrameProcessor processor;
+    ResultSaver saver;
+
+    StreamPipeline(const std::string& videoFilePath, int framesPerSecond, ThreadSafeQueue<Inference*>& inferencePool,
+                   const std::string& outputFilePath, int fps, cv::Size frameSize)
+        : reader(videoFilePath, frameQueue, framesPerSecond),
+          processor(frameQueue, resultQueue, inferencePool),
+          saver(resultQueue, outputFilePath, fps, frameSize) {}
+};
+
+int main(int argc, char** argv) {
+    namespace fs = std::filesystem;
+    fs::path current_path = fs::current_path();
+
+    // --threads N sizes the one pool every stage, OpenCV and Eigen run on.
+    std::vector<std::string> videoFilePaths;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--threads" && i + 1 < argc) {
+            Executor::configure(std::stoi(argv[++i]));
+            continue;
+        }
+        videoFilePaths.push_back(argv[i]);
+    }
+    if (videoFilePaths.empty()) {
+        videoFilePaths.push_back(current_path.string() + "/1.mp4");
+    }
+    int framesPerSecond = 1;
+
+    // All pipelines share one executor and as many network replicas as it has threads.
+    Executor& shared = Executor::instance();
+    shared.installOpenCVBackend();
+    CoroExecutor executor(shared);
+    std::cout << "Running " << videoFilePaths.size() << " streams on " << executor.size() << " threads." << std::endl;
+
+    std::string projectBasePath = current_path.string() + "/ultralytics";
+    bool runOnGPU = false;
+
+    std::vector<std::unique_ptr<Inference>> replicas;
+    ThreadSafeQueue<Inference*> inferencePool;
+    for (int i = 0; i < executor.size(); ++i) {
+        replicas.push_back(std::make_unique<Inference>(projectBasePath + "/yolov8s.onnx", cv::Size(640, 640), "classes.txt", runOnGPU));
+        inferencePool.push(replicas.back().get());
+    }
+
+    std::deque<StreamPipeline> pipelines;
+    for (size_t i = 0; i < videoFilePaths.size(); ++i) {
+        cv::VideoCapture cap(videoFilePaths[i]);
+        if (!cap.isOpened()) {
+            std::cerr << "Error: Could not open video file " << videoFilePaths[i] << std::endl;
+            continue;
+        }
+        int fps = static_cast<int>(cap.get(cv::CAP_PROP_FPS));
+        cv::Size frameSize(
+            static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)),
+            static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT))
+            );
+        cap.release();
+
+        std::string outputFilePath = "output_" + std::to_string(i) + ".avi";
+        pipelines.emplace_back(videoFilePaths[i], framesPerSecond, inferencePool, outputFilePath, fps, frameSize);
+    }
+
+    std::vector<Task> tasks;
+    for (StreamPipeline& pipeline : pipelines) {
+        tasks.push_back(pipeline.reader.run(executor));
+        tasks.push_back(pipeline.processor.run(executor));
+        tasks.push_back(pipeline.saver.run(executor));
+    }
+    for (Task& task : tasks) {
+        task.start(executor);
+    }
+    for (Task& task : tasks) {
+        task.join();
+    }
+
+    shared.printStats(std::cout);
+    return 0;
+}
@@ -0,0 +1,171 @@
+// Author: shaoshengsong
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <opencv2/opencv.hpp>
+#include "inference.h"
+#include "executor.h"
+#include "file_io.h"
+#include "FrameQueue.h"
+#include "ImageSet.h"
+
+using namespace std;
+using namespace cv;
+
+// Image-set mode: detections for every image of a directory, list file or
+// glob pattern.
+//   YOLOv8DetImages [images] [batch size] [output.csv or -] [decode threads] [model] [I/O queue depth]
+// Files are read through the asynchronous I/O layer, then decoded and scaled
+// to the network input on the shared executor while the previous batch runs;
+// detections are appended to the CSV as each batch completes, one row per
+// detection.
+struct DecodedImage {
+    size_t index{0};
+    PreparedFrame frame;
+};
+
+int main(int argc, char** argv) {
+    namespace fs = std::filesystem;
+    fs::path current_path = fs::current_path();
+    std::string source = (argc > 1) ? argv[1] : (current_path / "images").string();
+    size_t batchSize = (argc > 2) ? std::max(1, std::stoi(argv[2])) : 8;
+    std::string outputPath = (argc > 3) ? argv[3] : "detections.csv";
+    int decodeThreads = (argc > 4) ? std::stoi(argv[4]) : 0;
+    std::string modelPath = (argc > 5) ? argv[5] : current_path.string() + "/ultralytics/yolov8s.onnx";
+    FileIOOptions ioOptions;
+    ioOptions.queueDepth = (argc > 6) ? static_cast<unsigned>(std::max(1, std::stoi(argv[6]))) : 64;
+    FileIO::configure(ioOptions);
+
+    std::vector<std::string> paths;
+    try {
+        paths = listImages(source);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+
+    Executor::configure(decodeThreads);
+    Executor& executor = Executor::instance();
+    FileIO& io = FileIO::instance();
+
+    const cv::Size modelSize(640, 640);
+    Inference inf(modelPath, modelSize, "classes.txt", false);
+    std::shared_ptr<const ClassTable> classTable = inf.getClassTable();
+    inf.warmup({}, static_cast<int>(batchSize));
+
+    std::unique_ptr<AsyncLogWriter> log;
+    if (outputPath != "-") {
+        log = std::make_unique<AsyncLogWriter>(outputPath);
+    }
+    auto emit = [&log](const std::string& text) {
+        if (log) {
+            log->write(text);
+        } else {
+            std::cout << text << std::flush;
+        }
+    };
+    emit("image,class,confidence,x,y,width,height\n");
+
+    // Decoding runs at most a few batches ahead, which bounds memory however
+    // large the set is.
+    ThreadSafeQueue<DecodedImage> decoded;
+    const size_t window = 2 * batchSize + executor.size();
+    size_t submitted = 0;
+    size_t received = 0;
+    long unreadable = 0;
+    long detectionCount = 0;
+    double inferenceMs = 0.0;
+
+    std::vector<DecodedImage> batch;
+    std::vector<PreparedFrame> frames;
+    std::vector<std::vector<CompactDetection>> results;
+    // Models exported with a fixed batch of 1 (the Ultralytics default)
+    // reject the first batch; from then on images run one at a time.
+    bool batched = batchSize > 1;
+    auto flush = [&]() {
+        frames.clear();
+        for (const DecodedImage& image : batch) {
+            frames.push_back(image.frame);
+        }
+        auto begin = std::chrono::steady_clock::now();
+        if (batched) {
+            try {
+                inf.runInference(frames, results);
+            } catch (const std::exception& e) {
+                std::cerr << "Running images one at a time: " << e.what() << std::endl;
+                batched = false;
+            }
+        }
+        if (!batched) {
+            results.resize(frames.size());
+            for (size_t i = 0; i < frames.size(); ++i) {
+                inf.runInference(frames[i], results[i]);
+            }
+        }
+        inferenceMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        std::ostringstream rows;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            for (const CompactDetection& compact : results[i]) {
+                Detection detection = toDetection(compact, *classTable);
+                rows << paths[batch[i].index] << ',' << detection.className << ',' << detection.confidence << ','
+                     << detection.box.x << ',' << detection.box.y << ',' << detection.box.width << ',' << detection.box.height << '\n';
+                detectionCount++;
+            }
+        }
+        emit(rows.str());
+        batch.clear();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    while (received < paths.size()) {
+        while (submitted < paths.size() && submitted - received < window) {
+            size_t index = submitted++;
+            // The completion only hands the bytes over; decoding runs on the executor.
+            io.read(paths[index], [&decoded, &paths, &executor, index, modelSize](std::vector<uint8_t>&& data, const std::string& error) {
+                if (!error.empty()) {
+                    decoded.push(DecodedImage{ index, PreparedFrame() });
+                    return;
+                }
+                auto bytes = std::make_shared<std::vector<uint8_t>>(std::move(data));
+                executor.schedule([&decoded, &paths, index, modelSize, bytes] {
+                    decoded.push(DecodedImage{ index, decodeImage(*bytes, modelSize, paths[index]) });
+                });
+            });
+        }
+
+        DecodedImage image;
+        decoded.waitAndPop(image);
+        received++;
+        if (image.frame.image.empty()) {
+            std::cerr << "Warning: could not read " << paths[image.index] << std::endl;
+            unreadable++;
+        } else {
+            batch.push_back(std::move(image));
+        }
+        if (batch.size() == batchSize || (received == paths.size() && !batch.empty())) {
+            flush();
+        }
+    }
+    if (log) {
+        try {
+            log->flush();
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return -1;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long processed = static_cast<long>(paths.size()) - unreadable;
+    std::cout << processed << " images (" << unreadable << " unreadable), " << detectionCount << " detections in "
+              << seconds << " s: " << cv::format("%.1f", processed / seconds) << " images/s, inference "
+              << cv::format("%.1f", processed ? inferenceMs / processed : 0.0) << " ms/image at batch " << batchSize
+              << ", " << executor.size() << " decode threads, " << io.backend() << " I/O" << std::endl;
+    inf.getStartupStats().print(std::cout);
+    return 0;
+}
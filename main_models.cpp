@@ -0,0 +1,146 @@
+// Author: shaoshengsong
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "FrameQueue.h"
+#include "FrameResult.h"
+#include "ModelRegistry.h"
+#include "ResultSaver.h"
+
+using namespace std;
+using namespace cv;
+
+// Reads one video and sends its frames through the registry, keeping up to
+// window of them in flight; results reach the saver in frame order.
+static void processStream(int stream, const std::string& videoFilePath, ModelRegistry& registry, size_t window) {
+    cv::VideoCapture cap(videoFilePath);
+    if (!cap.isOpened()) {
+        throw std::runtime_error("Could not open video file " + videoFilePath);
+    }
+    int fps = static_cast<int>(cap.get(cv::CAP_PROP_FPS));
+    cv::Size frameSize(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+
+    ThreadSafeQueue<FrameResult> resultQueue;
+    ResultSaver saver(resultQueue, "output_" + std::to_string(stream) + ".avi", fps, frameSize);
+    std::thread saveThread(saver);
+
+    std::deque<std::pair<FrameResult, std::future<std::vector<Detection>>>> inFlight;
+    auto deliver = [&] {
+        FrameResult result = std::move(inFlight.front().first);
+        result.detections = inFlight.front().second.get();
+        inFlight.pop_front();
+        resultQueue.push(result);
+    };
+    try {
+        cv::Mat frame;
+        while (cap.read(frame)) {
+            FrameResult result;
+            result.frame = frame.clone();
+            result.captured = std::chrono::steady_clock::now();
+            inFlight.emplace_back(result, registry.submit(stream, result.frame));
+            if (inFlight.size() >= window) {
+                deliver();
+            }
+        }
+        while (!inFlight.empty()) {
+            deliver();
+        }
+    } catch (...) {
+        resultQueue.close();
+        saveThread.join();
+        throw;
+    }
+    resultQueue.close();
+    saveThread.join();
+}
+
+// Several cameras, each with its own model, served by one registry:
+//   YOLOv8DetModels [memory budget MB] [max batch] [video=model ...]
+// Models load when their first frame arrives and are evicted least recently
+// used first once the loaded ones exceed the budget; all of them share the
+// executor and the batching scheduler. Video i is written to output_<i>.avi.
+int main(int argc, char** argv) {
+    namespace fs = std::filesystem;
+    fs::path current_path = fs::current_path();
+    ModelRegistry::Options options;
+    options.memoryBudgetMb = (argc > 1) ? std::stod(argv[1]) : 1024.0;
+    options.maxBatch = (argc > 2) ? std::max(1, std::stoi(argv[2])) : 4;
+
+    std::vector<std::pair<std::string, std::string>> streams;
+    for (int i = 3; i < argc; ++i) {
+        std::string argument = argv[i];
+        size_t separator = argument.find('=');
+        if (separator == std::string::npos) {
+            std::cerr << "Error: expected video=model, got " << argument << std::endl;
+            return -1;
+        }
+        streams.emplace_back(argument.substr(0, separator), argument.substr(separator + 1));
+    }
+    if (streams.empty()) {
+        streams.emplace_back(current_path.string() + "/1.mp4", current_path.string() + "/ultralytics/yolov8s.onnx");
+    }
+
+    // Enough in flight per stream to fill a batch, and enough overall for
+    // every stream to have that much waiting.
+    const size_t window = static_cast<size_t>(options.maxBatch);
+    options.maxInFlight = window * streams.size();
+    ModelRegistry registry(options);
+
+    // One model per distinct path; streams sharing a model share its batches.
+    // Models are named by file stem, or by their whole path when another
+    // model already has that stem (a/yolov8s.onnx and b/yolov8s.onnx).
+    std::map<std::string, std::string> namesByPath;
+    std::set<std::string> names;
+    for (size_t i = 0; i < streams.size(); ++i) {
+        const std::string& path = streams[i].second;
+        auto known = namesByPath.find(path);
+        if (known == namesByPath.end()) {
+            std::string name = fs::path(path).stem().string();
+            if (names.count(name)) {
+                name = path;
+            }
+            if (names.count(name)) {
+                // Only if some other model's stem is this whole path.
+                name = path + "#" + std::to_string(i);
+            }
+            ModelSpec spec;
+            spec.path = path;
+            registry.addModel(name, spec);
+            names.insert(name);
+            known = namesByPath.emplace(path, name).first;
+        }
+        const std::string& name = known->second;
+        registry.route(static_cast<int>(i), name);
+        std::cout << "Stream " << i << ": " << streams[i].first << " -> " << name << std::endl;
+    }
+
+    std::vector<std::thread> threads;
+    int failures = 0;
+    std::mutex failureMutex;
+    for (size_t i = 0; i < streams.size(); ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                processStream(static_cast<int>(i), streams[i].first, registry, window);
+            } catch (const std::exception& e) {
+                std::cerr << "Stream " << i << ": " << e.what() << std::endl;
+                std::lock_guard<std::mutex> lock(failureMutex);
+                failures++;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    registry.printStats(std::cout);
+    Executor::instance().printStats(std::cout);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,30 @@
+// Author: shaoshengsong
+#include <iostream>
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+#include "Pipeline.h"
+#include "PipelineStages.h"
+
+using namespace std;
+using namespace cv;
+
+// Builds the stage graph from a config file (default pipeline.yml) and runs it.
+int main(int argc, char** argv) {
+    namespace fs = std::filesystem;
+    std::string configPath = argc > 1 ? argv[1] : (fs::current_path() / "pipeline.yml").string();
+
+    Pipeline pipeline;
+    registerBuiltinStages(pipeline);
+
+    try {
+        pipeline.load(configPath);
+        pipeline.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        pipeline.printStats(std::cerr);
+        return 1;
+    }
+
+    pipeline.printStats(std::cout);
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Author: shaoshengsong
+#include <algorithm>
+#include <iostream>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "FrameQueue.h"
+#include "VideoReader.h"
+#include "FrameProcessor.h"
+#include "ResultSaver.h"
+#include "inference.h"
+#include "FrameResult.h"
+#include "Supervisor.h"
+
+using namespace std;
+using namespace cv;
+
+// Runs one video through reader, processor and saver threads, borrowing the
+// worker's network from inferencePool.
+static void processStream(const std::string& videoFilePath, const std::string& outputFilePath, ThreadSafeQueue<Inference*>& inferencePool) {
+    cv::VideoCapture cap(videoFilePath);
+    if (!cap.isOpened()) {
+        throw std::runtime_error("Could not open video file " + videoFilePath);
+    }
+    int fps = static_cast<int>(cap.get(cv::CAP_PROP_FPS));
+    cv::Size frameSize(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+    cap.release();
+
+    ThreadSafeQueue<TimedFrame> frameQueue;
+    ThreadSafeQueue<FrameResult> resultQueue;
+    VideoReader reader(videoFilePath, frameQueue, 1);
+    FrameProcessor processor(frameQueue, resultQueue, inferencePool);
+    ResultSaver saver(resultQueue, outputFilePath, fps, frameSize);
+
+    std::thread videoThread(reader);
+    std::thread processThread(processor);
+    std::thread saveThread(saver);
+    videoThread.join();
+    processThread.join();
+    saveThread.join();
+}
+
+// Prefork mode: the supervisor loads and warms the network once, then forks
+// worker processes that share its weight pages copy-on-write.
+//   YOLOv8DetPrefork [workers] [model] [video ...]
+// Worker w handles videos w, w + workers, ... and writes output_<index>.avi
+// for each; a crashed worker is restarted. Unique memory per worker is
+// reported while they run.
+int main(int argc, char** argv) {
+    namespace fs = std::filesystem;
+    fs::path current_path = fs::current_path();
+    int workerCount = (argc > 1) ? std::max(1, std::stoi(argv[1])) : 2;
+    std::string modelPath = (argc > 2) ? argv[2] : current_path.string() + "/ultralytics/yolov8s.onnx";
+    std::vector<std::string> videos;
+    for (int i = 3; i < argc; ++i) {
+        videos.push_back(argv[i]);
+    }
+    if (videos.empty()) {
+        videos.push_back(current_path.string() + "/1.mp4");
+    }
+
+    // Only the forking thread survives fork(), so OpenCV must not have started
+    // its pool yet; every worker starts its own share of the cores instead.
+    int threadsPerWorker = std::max(1, cv::getNumberOfCPUs() / workerCount);
+    cv::setNumThreads(0);
+
+    // Warming up before the fork matters: layers pack their weights and
+    // allocate their buffers on the first forward, and what happens in the
+    // supervisor is shared instead of repeated in every worker.
+    Inference inf(modelPath, cv::Size(640, 640), "classes.txt", false);
+    inf.warmup();
+    StartupStats startup = inf.getStartupStats();
+    std::cout << "Model loaded in " << startup.loadMs << " ms, warmed up in " << startup.warmupMs << " ms" << std::endl;
+
+    Supervisor::Options options;
+    options.workers = workerCount;
+    const size_t activeWorkers = std::min<size_t>(workerCount, videos.size());
+    Supervisor supervisor(videos, options, [&](int worker, const std::vector<std::string>& streams) {
+        cv::setNumThreads(threadsPerWorker);
+        ThreadSafeQueue<Inference*> inferencePool;
+        inferencePool.push(&inf);
+
+        // Streams of one worker run side by side and take turns on the network.
+        std::vector<std::thread> threads;
+        int failures = 0;
+        std::mutex failureMutex;
+        for (size_t k = 0; k < streams.size(); ++k) {
+            // Worker w's k-th video is video w + k * workers.
+            size_t index = worker + k * activeWorkers;
+            threads.emplace_back([&, k, index] {
+                try {
+                    processStream(streams[k], "output_" + std::to_string(index) + ".avi", inferencePool);
+                } catch (const std::exception& e) {
+                    std::cerr << "Worker " << worker << ": " << e.what() << std::endl;
+                    std::lock_guard<std::mutex> lock(failureMutex);
+                    failures++;
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        // Each worker's copy of the network records its own first detection.
+        std::cout << "Worker " << worker << ": ";
+        inf.getStartupStats().print(std::cout);
+        return failures == 0 ? 0 : 2;
+    });
+
+    int status = supervisor.run();
+    supervisor.printMemory(std::cout);
+    return status;
+}
@@ -0,0 +1,76 @@
+// Author: shaoshengsong
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+#include "inference.h"
+#include "TwoPassAnalyzer.h"
+
+using namespace std;
+using namespace cv;
+
+// Two-pass analysis of a video file:
+//   YOLOv8DetTwoPass [video] [trigger classes, e.g. "0,2"] [coarse fps] [output.csv] [keyframes]
+// Pass 1 samples at the coarse rate; every frame around a trigger detection is
+// then analysed. All detections go to the CSV with their frame time.
+int main(int argc, char** argv) {
+    namespace fs = std::filesystem;
+    fs::path current_path = fs::current_path();
+    std::string videoFilePath = (argc >= 2) ? argv[1] : current_path.string() + "/1.mp4";
+    std::string triggerClasses = (argc >= 3) ? argv[2] : "0";
+    std::string outputFilePath = (argc >= 5) ? argv[4] : "detections.csv";
+
+    TwoPassAnalyzer::Options options;
+    options.coarseFps = (argc >= 4) ? std::stod(argv[3]) : 1.0;
+    options.coarseKeyframes = (argc >= 6) && std::string(argv[5]) == "keyframes";
+    // A misspelled mode must not silently run the slower full scan.
+    int unexpected = (argc >= 6 && !options.coarseKeyframes) ? 5 : (argc > 6 ? 6 : 0);
+    if (unexpected) {
+        std::cerr << "Error: unexpected argument " << argv[unexpected]
+                  << "\nUsage: YOLOv8DetTwoPass [video] [trigger classes] [coarse fps] [output.csv] [keyframes]" << std::endl;
+        return -1;
+    }
+    std::stringstream classes(triggerClasses);
+    for (std::string id; std::getline(classes, id, ',');) {
+        options.triggerClasses.push_back(std::stoi(id));
+    }
+
+    std::string projectBasePath = current_path.string() + "/ultralytics";
+    bool runOnGPU = false;
+    Inference inf(projectBasePath + "/yolov8s.onnx", cv::Size(640, 640), "classes.txt", runOnGPU);
+
+    TwoPassAnalyzer analyzer(inf, options);
+    std::vector<AnalysedFrame> frames;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        frames = analyzer.analyse(videoFilePath);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ofstream csv(outputFilePath);
+    csv << "frame,time,pass,class,confidence,x,y,width,height" << std::endl;
+    long passFrames[3] = {0, 0, 0};
+    for (const AnalysedFrame& frame : frames) {
+        passFrames[frame.pass]++;
+        for (const Detection& detection : frame.detections) {
+            csv << frame.index << ',' << cv::format("%.3f", frame.timestamp) << ',' << frame.pass << ','
+                << detection.className << ',' << detection.confidence << ','
+                << detection.box.x << ',' << detection.box.y << ',' << detection.box.width << ',' << detection.box.height << std::endl;
+        }
+    }
+
+    double windowSeconds = 0.0;
+    for (const TwoPassAnalyzer::Window& window : analyzer.lastWindows()) {
+        windowSeconds += window.end - window.begin;
+    }
+    std::cout << "Pass 1 analysed " << passFrames[1] << " frames, pass 2 analysed " << passFrames[2]
+              << " frames in " << analyzer.lastWindows().size() << " windows (" << windowSeconds << " s), "
+              << seconds << " s total." << std::endl;
+    std::cout << "Detections written to " << outputFilePath << std::endl;
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Author: shaoshengsong
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include "SloController.h"
+
+// The reader queues every 30th frame of a 30 fps file at 1 fps sampling, so
+// the controller sees indices 0, 30, 60, ...; a stride of n must still keep
+// one in n of them.
+static int admitted(SloController& controller, int frames) {
+    int kept = 0;
+    for (long index = 0; index < frames * 30L; index += 30) {
+        if (controller.sample()) {
+            kept++;
+        }
+    }
+    return kept;
+}
+
+int main() {
+    SloController::Options options;
+    options.targetP99Ms = 100.0;
+    options.modelTiers = { "model.onnx" };
+    options.resolutions = { 640 };
+    options.maxSampleStride = 3;
+    options.windowFrames = 1;
+    std::ostringstream log;
+    SloController controller(options, [](const std::string&, const cv::Size&) -> std::unique_ptr<Inference> {
+        throw std::runtime_error("no network needed");
+    }, log);
+
+    int failures = 0;
+    auto expect = [&failures](int stride, int actual, int wanted) {
+        if (actual != wanted) {
+            std::cerr << "stride " << stride << ": admitted " << actual << " of 120, expected " << wanted << std::endl;
+            failures++;
+        }
+    };
+
+    expect(1, admitted(controller, 120), 120);
+
+    // One window over target steps down a level: the only model level is
+    // already the cheapest, so the next levels are strides 2 and 3.
+    controller.record(0.0, 0.0, 1000.0, 0);
+    if (controller.current().sampleStride != 2) {
+        std::cerr << "expected stride 2, got " << controller.current().sampleStride << std::endl;
+        return 1;
+    }
+    expect(2, admitted(controller, 120), 60);
+
+    controller.record(0.0, 0.0, 1000.0, 0);
+    expect(3, admitted(controller, 120), 40);
+
+    if (failures == 0) {
+        std::cout << "slo_sampling: ok" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
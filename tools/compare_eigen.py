@@ -0,0 +1,211 @@
+# Author: shaoshengsong
+"""Compare EigenEngine against onnxruntime on the same input.
+
+usage: python compare_eigen.py YOLOv8EigenForward model.onnx [size] [tolerance]
+       python compare_eigen.py YOLOv8EigenForward --random [size] [tolerance]
+
+YOLOv8EigenForward is the binary built from tools/eigen_forward.cpp. The model's
+weights are dumped with export_weights.py next to it, one seeded random image in
+[0, 1) goes through both, and the largest absolute difference of the
+(4 + nc, anchors) outputs is printed. The exit status is 1 when it exceeds
+tolerance (default 1e-3).
+
+--random builds a yolov8n-shaped graph (80 classes) with random BN-fused
+weights instead of loading a model, so no Ultralytics export is needed. It uses
+the same operators as the export: Split for chunk(), nearest Resize, MaxPool,
+and the DFL softmax over 16 bins.
+"""
+import os
+import subprocess
+import sys
+import tempfile
+
+import numpy as np
+import onnx
+import onnxruntime as ort
+from onnx import TensorProto, helper, numpy_helper
+
+import export_weights
+
+
+class RandomYOLOv8:
+    """Builds ultralytics' yolov8.yaml at the n scale (depth 0.33, width 0.25)."""
+
+    def __init__(self, seed=0, num_classes=80, reg_max=16):
+        self.rng = np.random.default_rng(seed)
+        self.nodes = []
+        self.initializers = []
+        self.num_classes = num_classes
+        self.reg_max = reg_max
+        self.count = 0
+
+    def name(self, prefix):
+        self.count += 1
+        return "%s_%d" % (prefix, self.count)
+
+    def constant(self, name, array):
+        self.initializers.append(numpy_helper.from_array(np.asarray(array), name))
+        return name
+
+    def node(self, op, inputs, **attrs):
+        output = self.name(op.lower())
+        self.nodes.append(helper.make_node(op, inputs, [output], name=output, **attrs))
+        return output
+
+    def conv(self, x, c1, c2, path, k=1, s=1, act=True):
+        # Named like the Ultralytics initializers, so export_weights keys them as is.
+        fan_in = c1 * k * k
+        weight = self.rng.normal(0.0, np.sqrt(2.0 / fan_in), (c2, c1, k, k)).astype(np.float32)
+        bias = self.rng.normal(0.0, 0.1, c2).astype(np.float32)
+        w = self.constant(path + ".weight", weight)
+        b = self.constant(path + ".bias", bias)
+        y = self.node("Conv", [x, w, b], kernel_shape=[k, k], strides=[s, s], pads=[k // 2] * 4)
+        if act:
+            y = self.node("Mul", [y, self.node("Sigmoid", [y])])
+        return y
+
+    def c2f(self, x, c1, c2, n, shortcut, path):
+        c = c2 // 2
+        y = self.conv(x, c1, 2 * c, path + ".cv1.conv")
+        split = self.constant(self.name("split"), np.array([c, c], dtype=np.int64))
+        outputs = [self.name("chunk"), self.name("chunk")]
+        self.nodes.append(helper.make_node("Split", [y, split], outputs, axis=1))
+        parts = list(outputs)
+        for i in range(n):
+            m = "%s.m.%d" % (path, i)
+            z = self.conv(self.conv(parts[-1], c, c, m + ".cv1.conv", 3), c, c, m + ".cv2.conv", 3)
+            if shortcut:
+                z = self.node("Add", [parts[-1], z])
+            parts.append(z)
+        return self.conv(self.node("Concat", parts, axis=1), (2 + n) * c, c2, path + ".cv2.conv")
+
+    def sppf(self, x, c1, c2, path):
+        c = c1 // 2
+        parts = [self.conv(x, c1, c, path + ".cv1.conv")]
+        for _ in range(3):
+            parts.append(self.node("MaxPool", [parts[-1]], kernel_shape=[5, 5], strides=[1, 1], pads=[2] * 4))
+        return self.conv(self.node("Concat", parts, axis=1), 4 * c, c2, path + ".cv2.conv")
+
+    def upsample(self, x):
+        scales = self.constant(self.name("scales"), np.array([1, 1, 2, 2], dtype=np.float32))
+        return self.node("Resize", [x, "", scales], mode="nearest",
+                         coordinate_transformation_mode="asymmetric", nearest_mode="floor")
+
+    def detect(self, features, channels, size):
+        nc, reg = self.num_classes, self.reg_max
+        c2 = max(16, channels[0] // 4, reg * 4)
+        c3 = max(channels[0], min(nc, 100))
+        boxes, scores = [], []
+        for i, (x, ch) in enumerate(zip(features, channels)):
+            b = "model.22.cv2.%d" % i
+            box = self.conv(self.conv(x, ch, c2, b + ".0.conv", 3), c2, c2, b + ".1.conv", 3)
+            box = self.conv(box, c2, 4 * reg, b + ".2", act=False)
+            c = "model.22.cv3.%d" % i
+            cls = self.conv(self.conv(x, ch, c3, c + ".0.conv", 3), c3, c3, c + ".1.conv", 3)
+            cls = self.conv(cls, c3, nc, c + ".2", act=False)
+            boxes.append(self.node("Reshape", [box, self.constant(self.name("shape"), np.array([1, 4 * reg, -1]))]))
+            scores.append(self.node("Reshape", [cls, self.constant(self.name("shape"), np.array([1, nc, -1]))]))
+
+        # DFL: expected bin of the softmax over reg_max logits per side.
+        box = self.node("Reshape", [self.node("Concat", boxes, axis=2),
+                                    self.constant(self.name("shape"), np.array([1, 4, reg, -1]))])
+        bins = self.constant(self.name("bins"), np.arange(reg, dtype=np.float32).reshape(1, 1, reg, 1))
+        axes = self.constant(self.name("axes"), np.array([2]))
+        distance = self.node("ReduceSum", [self.node("Mul", [self.node("Softmax", [box], axis=2), bins]), axes],
+                             keepdims=0)
+
+        anchors, strides = [], []
+        for stride in (8, 16, 32):
+            n = size // stride
+            y, x = np.meshgrid(np.arange(n), np.arange(n), indexing="ij")
+            anchors.append(np.stack([x.ravel(), y.ravel()]).astype(np.float32) + 0.5)
+            strides.append(np.full((1, n * n), stride, dtype=np.float32))
+        anchors = self.constant("anchors", np.concatenate(anchors, axis=1)[None])
+        strides = self.constant("strides", np.concatenate(strides, axis=1)[None])
+
+        lt_rb = [self.name("side"), self.name("side")]
+        self.nodes.append(helper.make_node("Split", [distance, self.constant(self.name("split"), np.array([2, 2]))],
+                                           lt_rb, axis=1))
+        lt, rb = lt_rb
+        half = self.constant(self.name("half"), np.array(0.5, dtype=np.float32))
+        centre = self.node("Add", [anchors, self.node("Mul", [self.node("Sub", [rb, lt]), half])])
+        wh = self.node("Add", [lt, rb])
+        dbox = self.node("Mul", [self.node("Concat", [centre, wh], axis=1), strides])
+        cls = self.node("Sigmoid", [self.node("Concat", scores, axis=2)])
+        return self.node("Concat", [dbox, cls], axis=1)
+
+    def build(self, size):
+        x = "images"
+        x = self.conv(x, 3, 16, "model.0.conv", 3, 2)
+        x = self.conv(x, 16, 32, "model.1.conv", 3, 2)
+        x = self.c2f(x, 32, 32, 1, True, "model.2")
+        x = self.conv(x, 32, 64, "model.3.conv", 3, 2)
+        p3 = self.c2f(x, 64, 64, 2, True, "model.4")
+        x = self.conv(p3, 64, 128, "model.5.conv", 3, 2)
+        p4 = self.c2f(x, 128, 128, 2, True, "model.6")
+        x = self.conv(p4, 128, 256, "model.7.conv", 3, 2)
+        x = self.c2f(x, 256, 256, 1, True, "model.8")
+        p5 = self.sppf(x, 256, 256, "model.9")
+
+        n4 = self.c2f(self.node("Concat", [self.upsample(p5), p4], axis=1), 384, 128, 1, False, "model.12")
+        out3 = self.c2f(self.node("Concat", [self.upsample(n4), p3], axis=1), 192, 64, 1, False, "model.15")
+        x = self.conv(out3, 64, 64, "model.16.conv", 3, 2)
+        out4 = self.c2f(self.node("Concat", [x, n4], axis=1), 192, 128, 1, False, "model.18")
+        x = self.conv(out4, 128, 128, "model.19.conv", 3, 2)
+        out5 = self.c2f(self.node("Concat", [x, p5], axis=1), 384, 256, 1, False, "model.21")
+
+        output = self.detect([out3, out4, out5], [64, 128, 256], size)
+        self.nodes.append(helper.make_node("Identity", [output], ["output0"]))
+        graph = helper.make_graph(
+            self.nodes, "yolov8n_random",
+            [helper.make_tensor_value_info("images", TensorProto.FLOAT, [1, 3, size, size])],
+            [helper.make_tensor_value_info("output0", TensorProto.FLOAT, None)],
+            self.initializers)
+        # IR version 8 is the one opset 17 shipped with; older onnxruntime builds
+        # refuse models stamped with a newer one.
+        return helper.make_model(graph, opset_imports=[helper.make_opsetid("", 17)], ir_version=8)
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__)
+        return 1
+    forward = os.path.abspath(sys.argv[1])
+    size = int(sys.argv[3]) if len(sys.argv) > 3 else 640
+    tolerance = float(sys.argv[4]) if len(sys.argv) > 4 else 1e-3
+
+    with tempfile.TemporaryDirectory() as work:
+        if sys.argv[2] == "--random":
+            model = RandomYOLOv8().build(size)
+        else:
+            model = onnx.load(sys.argv[2])
+        model_path = os.path.join(work, "model.onnx")
+        weights_path = os.path.join(work, "model.y8w")
+        onnx.save(model, model_path)
+        export_weights.write_weights(export_weights.collect_conv_weights(model.graph), weights_path)
+
+        image = np.random.default_rng(1).random((1, 3, size, size), dtype=np.float32)
+        session = ort.InferenceSession(model_path, providers=["CPUExecutionProvider"])
+        expected = session.run(None, {session.get_inputs()[0].name: image})[0][0]
+
+        input_path = os.path.join(work, "input.bin")
+        output_path = os.path.join(work, "output.bin")
+        image.tofile(input_path)
+        subprocess.run([forward, weights_path, input_path, str(size), str(size), output_path], check=True,
+                       stdout=subprocess.DEVNULL)
+        actual = np.fromfile(output_path, dtype=np.float32)
+        if actual.size != expected.size:
+            print("Output size %d, expected %s" % (actual.size, "x".join(map(str, expected.shape))))
+            return 1
+        actual = actual.reshape(expected.shape)
+
+    difference = np.abs(actual - expected)
+    worst = np.unravel_index(np.argmax(difference), difference.shape)
+    print("Output %s, max abs difference %.3g at %s (onnxruntime %.6g, eigen %.6g)"
+          % ("x".join(map(str, expected.shape)), difference[worst], worst, expected[worst], actual[worst]))
+    print("Boxes max abs difference %.3g, scores %.3g" % (difference[:4].max(), difference[4:].max()))
+    return 0 if difference.max() <= tolerance else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,42 @@
+// Author: shaoshengsong
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "eigen_engine.h"
+
+// Runs EigenEngine once on a raw input blob, for tools/compare_eigen.py:
+//   YOLOv8EigenForward weights.y8w input.bin width height output.bin [threads]
+// input.bin holds the float32 NCHW (1, 3, height, width) blob; output.bin
+// receives the float32 (4 + classes, anchors) output, row-major like the ONNX
+// model's.
+int main(int argc, char** argv) {
+    if (argc < 6) {
+        std::cerr << "usage: " << argv[0] << " weights.y8w input.bin width height output.bin [threads]" << std::endl;
+        return -1;
+    }
+    const int width = std::stoi(argv[3]);
+    const int height = std::stoi(argv[4]);
+    const int threads = (argc > 6) ? std::stoi(argv[6]) : 0;
+
+    std::vector<float> input(static_cast<size_t>(3) * width * height);
+    std::ifstream inputFile(argv[2], std::ios::binary);
+    inputFile.read(reinterpret_cast<char*>(input.data()), input.size() * sizeof(float));
+    if (!inputFile) {
+        std::cerr << "Error: " << argv[2] << " does not hold a 3x" << height << "x" << width << " float blob" << std::endl;
+        return -1;
+    }
+
+    EigenEngine engine(argv[1], threads);
+    std::vector<float> output;
+    engine.forward(input.data(), width, height, output);
+
+    std::ofstream outputFile(argv[5], std::ios::binary);
+    outputFile.write(reinterpret_cast<const char*>(output.data()), output.size() * sizeof(float));
+    if (!outputFile) {
+        std::cerr << "Error: could not write " << argv[5] << std::endl;
+        return -1;
+    }
+    std::cout << engine.outputChannels() << " " << engine.anchorCount(width, height) << std::endl;
+    return 0;
+}
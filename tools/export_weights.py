@@ -0,0 +1,93 @@
+# Author: shaoshengsong
+"""Dump the Conv weights of an Ultralytics YOLOv8 ONNX export for EigenEngine.
+
+usage: python export_weights.py yolov8s.onnx [yolov8s.y8w]
+
+The export already folds BatchNorm into the convolutions, so every Conv node
+carries a weight and a bias. Tensors are keyed by their PyTorch module path
+(model.2.m.0.cv1.conv.weight, ...), recovered from the initializer name when the
+exporter kept it and from the node scope (/model.2/m.0/cv1/conv/Conv) otherwise.
+
+File layout, little endian:
+    char[4]  "Y8W1"
+    uint32   tensor count
+    per tensor: uint32 name length, name, uint32 rank, int32 dims[rank], float32 data
+"""
+import struct
+import sys
+
+import numpy as np
+import onnx
+from onnx import numpy_helper
+
+
+def module_path(node_name):
+    # "/model.22/cv2.0/cv2.0.0/conv/Conv" -> "model.22.cv2.0.0.conv"
+    scopes = [s for s in node_name.strip("/").split("/")[:-1] if s]
+    path = []
+    previous = ""
+    for scope in scopes:
+        if previous and scope.startswith(previous + "."):
+            path.append(scope[len(previous) + 1:])
+        else:
+            path.append(scope)
+        previous = scope
+    return ".".join(path)
+
+
+def collect_constants(graph):
+    tensors = {init.name: numpy_helper.to_array(init) for init in graph.initializer}
+    for node in graph.node:
+        if node.op_type == "Constant":
+            for attr in node.attribute:
+                if attr.name == "value":
+                    tensors[node.output[0]] = numpy_helper.to_array(attr.t)
+    return tensors
+
+
+def collect_conv_weights(graph):
+    tensors = collect_constants(graph)
+    weights = {}
+    for node in graph.node:
+        if node.op_type != "Conv":
+            continue
+        names = ["weight", "bias"]
+        for name, source in zip(names, node.input[1:]):
+            if source not in tensors:
+                continue
+            if source.startswith("model.") and source.endswith("." + name):
+                key = source
+            else:
+                key = module_path(node.name) + "." + name
+            weights[key] = tensors[source].astype(np.float32)
+    return weights
+
+
+def write_weights(weights, path):
+    with open(path, "wb") as f:
+        f.write(b"Y8W1")
+        f.write(struct.pack("<I", len(weights)))
+        for name, array in weights.items():
+            encoded = name.encode("utf-8")
+            f.write(struct.pack("<I", len(encoded)))
+            f.write(encoded)
+            f.write(struct.pack("<I", array.ndim))
+            f.write(struct.pack("<%di" % array.ndim, *array.shape))
+            f.write(np.ascontiguousarray(array, dtype="<f4").tobytes())
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    onnx_path = sys.argv[1]
+    out_path = sys.argv[2] if len(sys.argv) > 2 else onnx_path.rsplit(".", 1)[0] + ".y8w"
+
+    weights = collect_conv_weights(onnx.load(onnx_path).graph)
+    write_weights(weights, out_path)
+    print("Wrote %d tensors to %s" % (len(weights), out_path))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,153 @@
+// Author: shaoshengsong
+#ifndef ASYNCINFERENCE_H
+#define ASYNCINFERENCE_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "executor.h"
+#include "inference.h"
+
+// Runs Inference requests on an internal pool of replicas. Each replica owns
+// its own network; a replica with queued work runs as a task on the shared
+// Executor, so requests on different replicas run concurrently without any
+// threads of their own. At most maxInFlight requests are queued or running;
+// submit() blocks only once that bound is reached.
+class AsyncInference {
+public:
+    using Factory = std::function<std::unique_ptr<Inference>()>;
+    using Callback = std::function<void(std::vector<Detection> detections, std::exception_ptr error)>;
+
+    AsyncInference(const Factory& factory, int replicas = 1, size_t maxInFlight = 8)
+        : maxInFlight(std::max<size_t>(1, maxInFlight)), executor(Executor::instance()) {
+        for (int i = 0; i < std::max(1, replicas); ++i) {
+            replicasOwned.push_back(factory());
+            idle.push_back(replicasOwned.back().get());
+        }
+    }
+
+    // Completes every queued request before the replicas go away.
+    ~AsyncInference() {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return pending == 0 && active == 0; });
+    }
+
+    AsyncInference(const AsyncInference&) = delete;
+    AsyncInference& operator=(const AsyncInference&) = delete;
+
+    std::future<std::vector<Detection>> submit(const cv::Mat& frame) {
+        auto promise = std::make_shared<std::promise<std::vector<Detection>>>();
+        std::future<std::vector<Detection>> result = promise->get_future();
+        enqueue([frame, promise](Inference& inf) {
+            try {
+                promise->set_value(inf.runInference(frame));
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        return result;
+    }
+
+    // The callback runs on the Executor worker that served the request.
+    void submit(const cv::Mat& frame, Callback callback) {
+        enqueue([frame, callback](Inference& inf) {
+            std::vector<Detection> detections;
+            std::exception_ptr error;
+            try {
+                detections = inf.runInference(frame);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            callback(std::move(detections), error);
+        });
+    }
+
+    size_t inFlight() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending;
+    }
+
+    // Blocks until every submitted request has completed.
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    using Job = std::function<void(Inference&)>;
+
+    void enqueue(Job job) {
+        Inference* replica = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] { return pending < maxInFlight; });
+            jobs.push_back(std::move(job));
+            pending++;
+            if (!idle.empty()) {
+                replica = idle.back();
+                idle.pop_back();
+                active++;
+            }
+        }
+        if (replica) {
+            executor.schedule([this, replica] { serve(replica); });
+        }
+    }
+
+    // Serves one request, then either reschedules itself behind other work on
+    // the executor or parks the replica until the next submit(). Another
+    // replica may have taken the request this serve was scheduled for (one
+    // woken by enqueue() while a busy one was finishing), so it parks at once
+    // when nothing is left.
+    void serve(Inference* replica) {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobs.empty()) {
+                idle.push_back(replica);
+                active--;
+                notFull.notify_all();
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        job(*replica);
+
+        bool more;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+            more = !jobs.empty();
+            if (!more) {
+                idle.push_back(replica);
+                active--;
+            }
+            // Notify under the lock: the destructor may run as soon as it
+            // observes the final decrement.
+            notFull.notify_all();
+        }
+        if (more) {
+            executor.schedule([this, replica] { serve(replica); });
+        }
+    }
+
+    size_t maxInFlight;
+    size_t pending{0};
+    int active{0};
+    std::deque<Job> jobs;
+    std::vector<std::unique_ptr<Inference>> replicasOwned;
+    std::vector<Inference*> idle;
+    mutable std::mutex mutex;
+    std::condition_variable notFull;
+    Executor& executor;
+};
+
+#endif // ASYNCINFERENCE_H
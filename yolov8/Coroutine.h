@@ -0,0 +1,198 @@
+// Author: shaoshengsong
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+// Coroutine execution mode for the pipeline stages. Only available when the
+// translation unit is compiled as C++20; the thread-per-stage mode does not
+// depend on anything in here.
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define YOLOV8_COROUTINES 1
+
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "executor.h"
+
+// Resumes coroutine handles either on a small fixed pool of its own threads
+// (FIFO order) or, when constructed from an Executor, on the shared
+// work-stealing pool.
+class CoroExecutor {
+public:
+    explicit CoroExecutor(Executor& shared) : shared(&shared) {}
+
+    explicit CoroExecutor(int numThreads = 0) {
+        if (numThreads <= 0) {
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (int i = 0; i < numThreads; ++i) {
+            threads.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~CoroExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    CoroExecutor(const CoroExecutor&) = delete;
+    CoroExecutor& operator=(const CoroExecutor&) = delete;
+
+    void post(std::coroutine_handle<> handle) {
+        if (shared) {
+            shared->schedule([handle] { handle.resume(); });
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(handle);
+        }
+        condition.notify_one();
+    }
+
+    // co_await executor.schedule() continues the coroutine on a pool thread.
+    auto schedule() {
+        struct Awaiter {
+            CoroExecutor& executor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { executor.post(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+
+    // Re-queues the coroutine behind everything already runnable.
+    auto yield() { return schedule(); }
+
+    int size() const { return shared ? shared->size() : static_cast<int>(threads.size()); }
+
+private:
+    void workerLoop() {
+        while (true) {
+            std::coroutine_handle<> handle;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stopping || !ready.empty(); });
+                if (ready.empty()) {
+                    return;
+                }
+                handle = ready.front();
+                ready.pop_front();
+            }
+            handle.resume();
+        }
+    }
+
+    std::deque<std::coroutine_handle<>> ready;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping{false};
+    std::vector<std::thread> threads;
+    Executor* shared{nullptr};
+};
+
+// Lazily started coroutine. Either co_await it from another coroutine or
+// start() it on an executor and join() it from a plain thread.
+class Task {
+public:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool done{false};
+        std::exception_ptr error;
+    };
+
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        std::shared_ptr<State> state = std::make_shared<State>();
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        auto final_suspend() noexcept {
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    promise_type& promise = handle.promise();
+                    if (promise.continuation) {
+                        return promise.continuation;
+                    }
+                    // Joiners may destroy the frame as soon as done is set,
+                    // so only the shared state is touched from here on.
+                    std::shared_ptr<State> state = promise.state;
+                    {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        state->done = true;
+                    }
+                    state->condition.notify_all();
+                    return std::noop_coroutine();
+                }
+                void await_resume() const noexcept {}
+            };
+            return FinalAwaiter{};
+        }
+
+        void return_void() {}
+        void unhandled_exception() { state->error = std::current_exception(); }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Task() { destroy(); }
+
+    void start(CoroExecutor& executor) { executor.post(handle); }
+
+    void join() {
+        std::shared_ptr<State> state = handle.promise().state;
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->condition.wait(lock, [&state] { return state->done; });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    void await_resume() {
+        if (handle.promise().state->error) {
+            std::rethrow_exception(handle.promise().state->error);
+        }
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    void destroy() {
+        if (handle) {
+            handle.destroy();
+            handle = {};
+        }
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+#endif
+
+#endif // COROUTINE_H
@@ -0,0 +1,62 @@
+// Author: shaoshengsong
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "topology.h"
+
+// Recycles frame buffers so a stream does not go back to the allocator for
+// every frame. A buffer is free again once every cv::Mat header that shares it
+// downstream has been released, so consumers never return anything explicitly.
+// New buffers are first-touched by the thread that acquires them; with that
+// thread pinned, the pool's memory stays on the stream's NUMA node.
+class FramePool {
+public:
+    explicit FramePool(size_t capacity = 16) : capacity(capacity) {}
+
+    // Returns a rows x cols buffer of the given type that nothing else references.
+    cv::Mat acquire(int rows, int cols, int type) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (cv::Mat& buffer : buffers) {
+            if (idle(buffer) && buffer.rows == rows && buffer.cols == cols && buffer.type() == type) {
+                return buffer;
+            }
+        }
+
+        cv::Mat buffer(rows, cols, type);
+        firstTouch(buffer.data, buffer.total() * buffer.elemSize());
+        if (buffers.size() < capacity) {
+            buffers.push_back(buffer);
+        } else {
+            // Replace an idle buffer of another shape; if every buffer is in
+            // flight the new one is simply not pooled.
+            for (cv::Mat& pooled : buffers) {
+                if (idle(pooled)) {
+                    pooled = buffer;
+                    break;
+                }
+            }
+        }
+        return buffer;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return buffers.size();
+    }
+
+private:
+    // Only the pool still holds it. Other threads drop their references with
+    // CV_XADD, so the count is read the same way rather than as a plain int.
+    static bool idle(const cv::Mat& buffer) {
+        return buffer.u && CV_XADD(&buffer.u->refcount, 0) == 1;
+    }
+
+    size_t capacity;
+    std::vector<cv::Mat> buffers;
+    mutable std::mutex mutex;
+};
+
+#endif // FRAMEPOOL_H
@@ -3,32 +3,136 @@
 #ifndef FRAMEPROCESSOR_H
 #define FRAMEPROCESSOR_H
 
+#include <chrono>
 #include "FrameQueue.h"
 #include "Inference.h"
 #include "FrameResult.h"
+#include "LatencyMonitor.h"
+#include "SloController.h"
 
 class FrameProcessor {
 public:
-    FrameProcessor(ThreadSafeQueue<cv::Mat>& frameQueue, ThreadSafeQueue<FrameResult>& resultQueue, Inference& inf)
-        : frameQueue(frameQueue), resultQueue(resultQueue), inf(inf) {}
+    FrameProcessor(ThreadSafeQueue<TimedFrame>& frameQueue, ThreadSafeQueue<FrameResult>& resultQueue, Inference& inf)
+        : frameQueue(frameQueue), resultQueue(resultQueue), inf(&inf) {}
+
+    // Borrows a replica from a shared pool for each frame, so many pipelines
+    // can share a few networks.
+    FrameProcessor(ThreadSafeQueue<TimedFrame>& frameQueue, ThreadSafeQueue<FrameResult>& resultQueue, ThreadSafeQueue<Inference*>& inferencePool)
+        : frameQueue(frameQueue), resultQueue(resultQueue), inferencePool(&inferencePool) {}
+
+    // Live-latency mode: always serve the freshest queued frame and skip any
+    // frame that has already waited longer than budgetMs, instead of letting
+    // a backlog delay every later frame. Drops are reported to monitor.
+    void enableLatencyMode(double budgetMs, LatencyMonitor& monitor) {
+        latencyBudget = std::chrono::duration<double, std::milli>(budgetMs);
+        latencyMonitor = &monitor;
+    }
+
+    // Lets the controller pick the model, input size and sampling rate; it
+    // replaces the Inference (or pool) given to the constructor.
+    void setController(SloController& slo) {
+        controller = &slo;
+    }
 
     void operator()() {
         while (true) {
-            cv::Mat frame;
+            TimedFrame frame;
             if (frameQueue.waitAndPop(frame)) {
-                std::vector<Detection> output = inf.runInference(frame);
-                FrameResult frameResult = { frame, output };
+                if (!admit(frame)) {
+                    continue;
+                }
+                Inference* replica = inf;
+                if (controller) {
+                    replica = &controller->inference();
+                } else if (inferencePool) {
+                    inferencePool->waitAndPop(replica);
+                }
+                auto start = std::chrono::steady_clock::now();
+                std::vector<Detection> output = replica->runInference(frame.frame);
+                report(frame, start);
+                if (inferencePool && !controller) {
+                    inferencePool->push(replica);
+                }
+                FrameResult frameResult = { frame.frame, output, frame.captured, frame.timestamp };
                 resultQueue.push(frameResult);
             } else {
                 break;
             }
         }
+        resultQueue.close();
+    }
+
+#ifdef YOLOV8_COROUTINES
+    Task run(CoroExecutor& executor) {
+        co_await executor.schedule();
+
+        while (true) {
+            std::optional<TimedFrame> frame = co_await frameQueue.pop(executor);
+            if (!frame) {
+                break;
+            }
+            if (!admit(*frame)) {
+                continue;
+            }
+
+            Inference* replica = inf;
+            if (controller) {
+                replica = &controller->inference();
+            } else if (inferencePool) {
+                replica = *co_await inferencePool->pop(executor);
+            }
+            auto start = std::chrono::steady_clock::now();
+            std::vector<Detection> output = replica->runInference(frame->frame);
+            report(*frame, start);
+            if (inferencePool && !controller) {
+                inferencePool->push(replica);
+            }
+
+            FrameResult frameResult = { frame->frame, output, frame->captured, frame->timestamp };
+            resultQueue.push(frameResult);
+        }
+        resultQueue.close();
     }
+#endif
 
 private:
-    ThreadSafeQueue<cv::Mat>& frameQueue;
+    // In latency mode, swaps in the newest queued frame and rejects it if it
+    // is already over budget. With a controller, also skips frames outside
+    // its current sampling rate.
+    bool admit(TimedFrame& frame) {
+        if (controller && !controller->sample()) {
+            return false;
+        }
+        if (!latencyMonitor) {
+            return true;
+        }
+        size_t skipped = frameQueue.replaceWithLatest(frame);
+        if (skipped > 0) {
+            latencyMonitor->recordSuperseded(skipped);
+        }
+        if (std::chrono::steady_clock::now() - frame.captured > latencyBudget) {
+            latencyMonitor->recordStale();
+            return false;
+        }
+        return true;
+    }
+
+    void report(const TimedFrame& frame, std::chrono::steady_clock::time_point inferenceStart) {
+        if (!controller) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        auto ms = [](std::chrono::steady_clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+        controller->record(ms(inferenceStart - frame.captured), ms(now - inferenceStart), ms(now - frame.captured), frameQueue.size());
+    }
+
+    ThreadSafeQueue<TimedFrame>& frameQueue;
     ThreadSafeQueue<FrameResult>& resultQueue;
-    Inference& inf;
+    Inference* inf{nullptr};
+    ThreadSafeQueue<Inference*>* inferencePool{nullptr};
+    std::chrono::duration<double, std::milli> latencyBudget{0.0};
+    LatencyMonitor* latencyMonitor{nullptr};
+    SloController* controller{nullptr};
 };
 
 #endif // FRAMEPROCESSOR_H
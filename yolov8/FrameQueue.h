@@ -5,12 +5,36 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include "Coroutine.h"
+
+#ifdef YOLOV8_COROUTINES
+#include <optional>
+#endif
 
 template <typename T>
 class ThreadSafeQueue {
 public:
+    ThreadSafeQueue() = default;
+    // A non-zero capacity makes push() block while the queue is full, so a
+    // slow consumer applies back-pressure instead of letting frames pile up.
+    explicit ThreadSafeQueue(size_t capacity) : capacity_(capacity) {}
+
     void push(const T& value) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_lock<std::mutex> lock(mutex_);
+#ifdef YOLOV8_COROUTINES
+        if (!waiters_.empty()) {
+            // Hand the value straight to a suspended consumer.
+            Waiter waiter = waiters_.front();
+            waiters_.pop_front();
+            *waiter.slot = value;
+            lock.unlock();
+            waiter.executor->post(waiter.handle);
+            return;
+        }
+#endif
+        if (capacity_ > 0) {
+            notFull_.wait(lock, [this] { return queue_.size() < capacity_ || closed_; });
+        }
         queue_.push(value);
         condition_.notify_one();
     }
@@ -22,26 +46,109 @@ public:
         }
         value = queue_.front();
         queue_.pop();
+        notFull_.notify_one();
         return true;
     }
 
+    // Returns false once the queue is closed and drained.
     bool waitAndPop(T& value) {
         std::unique_lock<std::mutex> lock(mutex_);
-        condition_.wait(lock, [this] { return !queue_.empty(); });
+        condition_.wait(lock, [this] { return !queue_.empty() || closed_; });
+        if (queue_.empty()) {
+            return false;
+        }
         value = queue_.front();
         queue_.pop();
+        notFull_.notify_one();
         return true;
     }
 
+    // Replaces value with the newest queued element and discards everything
+    // older; returns how many elements were skipped (0 if the queue was empty).
+    size_t replaceWithLatest(T& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t skipped = queue_.size();
+        if (skipped == 0) {
+            return 0;
+        }
+        value = queue_.back();
+        std::queue<T>().swap(queue_);
+        notFull_.notify_all();
+        return skipped;
+    }
+
     bool empty() const {
         std::lock_guard<std::mutex> lock(mutex_);
         return queue_.empty();
     }
 
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    // Signals end of stream: consumers drain what is left and then stop.
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        condition_.notify_all();
+        notFull_.notify_all();
+#ifdef YOLOV8_COROUTINES
+        for (const Waiter& waiter : waiters_) {
+            waiter.executor->post(waiter.handle);
+        }
+        waiters_.clear();
+#endif
+    }
+
+#ifdef YOLOV8_COROUTINES
+    // co_await queue.pop(executor) suspends without holding a thread until a
+    // value arrives; yields std::nullopt once the queue is closed and drained.
+    auto pop(CoroExecutor& executor) {
+        struct Awaiter {
+            ThreadSafeQueue& queue;
+            CoroExecutor& executor;
+            std::optional<T> value;
+
+            bool await_ready() { return false; }
+
+            bool await_suspend(std::coroutine_handle<> handle) {
+                std::lock_guard<std::mutex> lock(queue.mutex_);
+                if (!queue.queue_.empty()) {
+                    value = queue.queue_.front();
+                    queue.queue_.pop();
+                    queue.notFull_.notify_one();
+                    return false;
+                }
+                if (queue.closed_) {
+                    return false;
+                }
+                queue.waiters_.push_back(Waiter{handle, &executor, &value});
+                return true;
+            }
+
+            std::optional<T> await_resume() { return std::move(value); }
+        };
+        return Awaiter{*this, executor, std::nullopt};
+    }
+#endif
+
 private:
     std::queue<T> queue_;
     mutable std::mutex mutex_;
     std::condition_variable condition_;
+    std::condition_variable notFull_;
+    size_t capacity_{0};
+    bool closed_{false};
+
+#ifdef YOLOV8_COROUTINES
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        CoroExecutor* executor;
+        std::optional<T>* slot;
+    };
+    std::deque<Waiter> waiters_;
+#endif
 };
 
 #endif // FRAMEQUEUE_H
@@ -3,12 +3,24 @@
 #define FRAMERESULT_H
 
 #include <opencv2/opencv.hpp>
+#include <chrono>
 #include <vector>
 #include "inference.h"
 
+// A decoded frame stamped when it was captured, so later stages can tell how
+// long it has been waiting, and with its position in the video.
+struct TimedFrame {
+    cv::Mat frame;
+    long index{0};
+    std::chrono::steady_clock::time_point captured{};
+    double timestamp{-1.0}; // seconds into the video, -1 if unknown
+};
+
 struct FrameResult {
     cv::Mat frame;
     std::vector<Detection> detections;
+    std::chrono::steady_clock::time_point captured{};
+    double timestamp{-1.0};
 };
 
 #endif // FRAMERESULT_H
@@ -0,0 +1,110 @@
+// Author: shaoshengsong
+#ifndef IMAGESET_H
+#define IMAGESET_H
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "inference.h"
+#include "jpeg_decoder.h"
+
+inline bool isImagePath(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    static const std::vector<std::string> known = {".jpg", ".jpeg", ".png", ".bmp", ".webp", ".tif", ".tiff"};
+    return std::find(known.begin(), known.end(), extension) != known.end();
+}
+
+// Image paths named by source: a directory (searched recursively), a text
+// file with one path per line (.txt or .lst), or a cv::glob pattern such as
+// "images/*.jpg". Sorted, so runs over the same set are comparable.
+inline std::vector<std::string> listImages(const std::string& source) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> paths;
+    fs::path sourcePath(source);
+    std::string extension = sourcePath.extension().string();
+
+    if (fs::is_directory(sourcePath)) {
+        for (const fs::directory_entry& entry : fs::recursive_directory_iterator(sourcePath)) {
+            if (entry.is_regular_file() && isImagePath(entry.path())) {
+                paths.push_back(entry.path().string());
+            }
+        }
+    } else if (fs::is_regular_file(sourcePath) && (extension == ".txt" || extension == ".lst")) {
+        std::ifstream list(source);
+        for (std::string line; std::getline(list, line);) {
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty()) {
+                paths.push_back(line);
+            }
+        }
+    } else {
+        std::vector<cv::String> matches;
+        cv::glob(source, matches, false);
+        paths.assign(matches.begin(), matches.end());
+    }
+
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        throw std::runtime_error("No images found for " + source);
+    }
+    return paths;
+}
+
+// Brings an encoded image (file contents) to the network input straight away
+// (square models: letterboxed top-left like Inference does; others:
+// stretched), so only the small copy is kept. JPEGs are decoded DCT-scaled to
+// the smallest size that still covers the input. Undecodable data gives an
+// empty image; name is only used in messages.
+inline PreparedFrame decodeImage(const std::vector<uint8_t>& data, const cv::Size& modelSize, const std::string& name = "") {
+    PreparedFrame frame;
+    const bool letterbox = modelSize.width == modelSize.height;
+    cv::Mat image;
+    if (data.empty()) {
+        return frame;
+    }
+    try {
+        if (!decodeJpeg(data, modelSize, letterbox, image, frame.sourceSize)) {
+            image = cv::imdecode(data, cv::IMREAD_COLOR);
+            frame.sourceSize = image.size();
+        }
+    } catch (const cv::Exception& e) {
+        std::cerr << "Warning: " << name << ": " << e.what() << std::endl;
+        image.release();
+    }
+    if (image.empty()) {
+        return frame;
+    }
+
+    cv::Size scaled = modelSize;
+    if (letterbox) {
+        // From the full size: the reduced decode rounds its dimensions up.
+        const cv::Size& source = frame.sourceSize;
+        double scale = std::min(double(modelSize.width) / source.width, double(modelSize.height) / source.height);
+        scaled = cv::Size(std::max(1, static_cast<int>(source.width * scale + 0.5)), std::max(1, static_cast<int>(source.height * scale + 0.5)));
+        scaled.width = std::min(scaled.width, modelSize.width);
+        scaled.height = std::min(scaled.height, modelSize.height);
+    }
+    int interpolation = scaled.area() < image.size().area() ? cv::INTER_AREA : cv::INTER_LINEAR;
+
+    frame.image = cv::Mat::zeros(modelSize.height, modelSize.width, CV_8UC3);
+    cv::Mat picture = frame.image(cv::Rect(0, 0, scaled.width, scaled.height));
+    cv::resize(image, picture, scaled, 0, 0, interpolation);
+    return frame;
+}
+
+// As above, reading the file with a blocking read.
+inline PreparedFrame decodeImage(const std::string& path, const cv::Size& modelSize) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return decodeImage(data, modelSize, path);
+}
+
+#endif // IMAGESET_H
@@ -0,0 +1,101 @@
+// Author: shaoshengsong
+#ifndef LATENCYMONITOR_H
+#define LATENCYMONITOR_H
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+struct LatencyStats {
+    long delivered{0};
+    long droppedStale{0};      // older than the budget when inference would start
+    long droppedSuperseded{0}; // skipped because a newer frame was already queued
+    // Glass-to-glass latency (capture to written result) over the recent window.
+    double meanMs{0.0};
+    double p50Ms{0.0};
+    double p95Ms{0.0};
+    double p99Ms{0.0};
+    double maxMs{0.0};
+
+    double dropRate() const {
+        long total = delivered + droppedStale + droppedSuperseded;
+        return total ? double(droppedStale + droppedSuperseded) / total : 0.0;
+    }
+};
+
+// Shared by the stages of one stream: the processor reports drops, the saver
+// reports each delivered frame. Percentiles cover the last `window` frames.
+class LatencyMonitor {
+public:
+    explicit LatencyMonitor(size_t window = 1024) : samples(std::max<size_t>(1, window)) {}
+
+    void recordDelivered(std::chrono::steady_clock::time_point captured) {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - captured).count();
+        std::lock_guard<std::mutex> lock(mutex);
+        samples[delivered % samples.size()] = ms;
+        delivered++;
+    }
+
+    void recordStale() {
+        std::lock_guard<std::mutex> lock(mutex);
+        droppedStale++;
+    }
+
+    void recordSuperseded(size_t count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        droppedSuperseded += static_cast<long>(count);
+    }
+
+    LatencyStats snapshot() const {
+        LatencyStats stats;
+        std::vector<double> recent;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.delivered = delivered;
+            stats.droppedStale = droppedStale;
+            stats.droppedSuperseded = droppedSuperseded;
+            size_t count = std::min<size_t>(delivered, samples.size());
+            recent.assign(samples.begin(), samples.begin() + count);
+        }
+        if (recent.empty()) {
+            return stats;
+        }
+
+        std::sort(recent.begin(), recent.end());
+        auto percentile = [&recent](double p) {
+            return recent[std::min(recent.size() - 1, static_cast<size_t>(p * recent.size()))];
+        };
+        double sum = 0.0;
+        for (double ms : recent) {
+            sum += ms;
+        }
+        stats.meanMs = sum / recent.size();
+        stats.p50Ms = percentile(0.50);
+        stats.p95Ms = percentile(0.95);
+        stats.p99Ms = percentile(0.99);
+        stats.maxMs = recent.back();
+        return stats;
+    }
+
+    void print(std::ostream& out) const {
+        LatencyStats stats = snapshot();
+        out << "delivered " << stats.delivered
+            << ", dropped stale " << stats.droppedStale
+            << ", dropped superseded " << stats.droppedSuperseded
+            << " (" << static_cast<int>(stats.dropRate() * 100.0) << "%)"
+            << ", glass-to-glass ms mean " << stats.meanMs
+            << " p50 " << stats.p50Ms << " p95 " << stats.p95Ms
+            << " p99 " << stats.p99Ms << " max " << stats.maxMs << std::endl;
+    }
+
+private:
+    std::vector<double> samples;
+    long delivered{0};
+    long droppedStale{0};
+    long droppedSuperseded{0};
+    mutable std::mutex mutex;
+};
+
+#endif // LATENCYMONITOR_H
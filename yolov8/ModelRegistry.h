@@ -0,0 +1,434 @@
+// Author: shaoshengsong
+#ifndef MODELREGISTRY_H
+#define MODELREGISTRY_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "executor.h"
+#include "inference.h"
+#include "ProcessMemory.h"
+
+// What a registered model is loaded from.
+struct ModelSpec {
+    std::string path;
+    std::string classes{"classes.txt"};
+    cv::Size inputSize{640, 640};
+    BackendOptions backend{};
+};
+
+struct ModelRegistryStats {
+    std::string name;
+    bool loaded{false};
+    long loads{0};
+    long evictions{0};
+    long batches{0};
+    long frames{0};
+    double memoryMb{0.0};  // measured at the last load, 0 if never loaded
+    double lastLoadMs{0.0};
+};
+
+// Several models behind one entry point, for cameras that need different
+// networks. Streams are routed to a model by name; a model is loaded (and
+// warmed up) when its first frame arrives, and stays loaded while the models
+// in memory fit memoryBudgetMb. Loading past the budget evicts the least
+// recently used idle models first.
+//
+// All models share one batching scheduler on the process-wide Executor:
+// frames queue per model, and whenever one of maxConcurrent slots is free
+// the next model with frames waiting (round-robin) runs everything it has
+// queued, up to maxBatch frames, as one batch. Models exported with a fixed
+// batch of 1 are found on their first batch and run frame by frame from
+// then on. At most maxInFlight frames are queued or running; submit() blocks
+// only once that bound is reached.
+//
+// A model's memory is what the process's unique memory grew by while it was
+// loaded and warmed up, or its file size if that is larger or /proc is not
+// available; before the first load the file size is the estimate. Batches of
+// other models allocate too, so a load waits for the running ones to finish
+// and starts no new ones until it is measured: loading pauses the registry.
+// Memory the process gains or frees on other threads meanwhile (decoders,
+// result writers) still shows up in the figure.
+class ModelRegistry {
+public:
+    using Callback = std::function<void(std::vector<Detection> detections, std::exception_ptr error)>;
+
+    struct Options {
+        double memoryBudgetMb{2048.0}; // 0 for no limit
+        int maxBatch{4};
+        int maxConcurrent{2};          // batches running at once, over all models
+        size_t maxInFlight{32};
+    };
+
+    ModelRegistry() : ModelRegistry(Options()) {}
+
+    explicit ModelRegistry(const Options& options)
+        : options(options), executor(Executor::instance()) {
+        this->options.maxBatch = std::max(1, options.maxBatch);
+        this->options.maxConcurrent = std::max(1, options.maxConcurrent);
+        this->options.maxInFlight = std::max<size_t>(1, options.maxInFlight);
+    }
+
+    // Completes every queued frame before the models go away.
+    ~ModelRegistry() {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return pending == 0 && running == 0; });
+    }
+
+    ModelRegistry(const ModelRegistry&) = delete;
+    ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+    // Registers a model without loading it; throws std::runtime_error if the
+    // name is taken.
+    void addModel(const std::string& name, const ModelSpec& spec) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unique_ptr<Entry>& entry = models[name];
+        if (entry) {
+            throw std::runtime_error("Model " + name + " is already registered");
+        }
+        entry = std::make_unique<Entry>();
+        entry->name = name;
+        entry->spec = spec;
+    }
+
+    // Sends the frames of stream to the model registered as name.
+    void route(int stream, const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        routes[stream] = find(name);
+    }
+
+    std::string modelFor(int stream) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = routes.find(stream);
+        return it == routes.end() ? std::string() : it->second->name;
+    }
+
+    // Throws std::runtime_error if the stream has no route.
+    std::future<std::vector<Detection>> submit(int stream, const cv::Mat& frame) {
+        auto promise = std::make_shared<std::promise<std::vector<Detection>>>();
+        std::future<std::vector<Detection>> result = promise->get_future();
+        submit(stream, frame, [promise](std::vector<Detection> detections, std::exception_ptr error) {
+            if (error) {
+                promise->set_exception(error);
+            } else {
+                promise->set_value(std::move(detections));
+            }
+        });
+        return result;
+    }
+
+    // The callback runs on the Executor worker that served the frame.
+    void submit(int stream, const cv::Mat& frame, Callback callback) {
+        std::vector<Entry*> started;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto it = routes.find(stream);
+            if (it == routes.end()) {
+                throw std::runtime_error("No model routed for stream " + std::to_string(stream));
+            }
+            Entry* entry = it->second;
+            notFull.wait(lock, [this] { return pending < options.maxInFlight; });
+            entry->queue.push_back({frame, std::move(callback)});
+            pending++;
+            if (!entry->running && !entry->ready) {
+                entry->ready = true;
+                ready.push_back(entry);
+            }
+            started = claimLocked();
+        }
+        start(started);
+    }
+
+    // Blocks until every submitted frame has completed.
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return pending == 0; });
+    }
+
+    double residentMb() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return residentKb / 1024.0;
+    }
+
+    std::vector<ModelRegistryStats> stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<ModelRegistryStats> result;
+        for (const auto& model : models) {
+            ModelRegistryStats entry = model.second->stats;
+            entry.name = model.first;
+            entry.loaded = model.second->loaded;
+            entry.memoryMb = model.second->memoryKb / 1024.0;
+            result.push_back(entry);
+        }
+        return result;
+    }
+
+    void printStats(std::ostream& out) const {
+        out << "Models: " << cv::format("%.0f", residentMb()) << " MB resident";
+        if (options.memoryBudgetMb > 0.0) {
+            out << " of " << cv::format("%.0f", options.memoryBudgetMb) << " MB";
+        }
+        out << std::endl;
+        for (const ModelRegistryStats& model : stats()) {
+            out << cv::format("  %-16s %-8s %7.1f MB, %ld loads (last %.0f ms), %ld evictions, %ld frames in %ld batches",
+                              model.name.c_str(), model.loaded ? "loaded" : "unloaded", model.memoryMb,
+                              model.loads, model.lastLoadMs, model.evictions, model.frames, model.batches)
+                << std::endl;
+        }
+    }
+
+private:
+    struct Request {
+        cv::Mat frame;
+        Callback callback;
+    };
+
+    struct Entry {
+        std::string name;
+        ModelSpec spec;
+        std::unique_ptr<Inference> inference; // only touched by the running batch or, when idle, by eviction
+        bool loaded{false};
+        std::deque<Request> queue;
+        bool ready{false};    // in the ready list
+        bool running{false};  // a batch of it is on the executor
+        bool batchable{true};
+        long lastUsed{0};
+        size_t memoryKb{0};
+        ModelRegistryStats stats;
+    };
+
+    Entry* find(const std::string& name) const {
+        auto it = models.find(name);
+        if (it == models.end()) {
+            throw std::runtime_error("Unknown model " + name);
+        }
+        return it->second.get();
+    }
+
+    // Claims slots for models with frames waiting, round-robin; call with
+    // mutex held, then start() the result after releasing it (the executor
+    // may run a task inline when its queue is full). A claimed slot counts as
+    // running, so the registry outlives start() whenever there is anything to
+    // start. Nothing starts while a load is being measured.
+    std::vector<Entry*> claimLocked() {
+        std::vector<Entry*> started;
+        while (!measuring && running < options.maxConcurrent && !ready.empty()) {
+            Entry* entry = ready.front();
+            ready.pop_front();
+            entry->ready = false;
+            entry->running = true;
+            running++;
+            started.push_back(entry);
+        }
+        return started;
+    }
+
+    void start(const std::vector<Entry*>& started) {
+        for (Entry* entry : started) {
+            executor.schedule([this, entry] { serve(entry); });
+        }
+    }
+
+    void serve(Entry* entry) {
+        std::vector<Request> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t size = entry->batchable ? static_cast<size_t>(options.maxBatch) : 1;
+            while (!entry->queue.empty() && batch.size() < size) {
+                batch.push_back(std::move(entry->queue.front()));
+                entry->queue.pop_front();
+            }
+            entry->lastUsed = ++clock;
+        }
+
+        std::vector<std::vector<Detection>> results(batch.size());
+        std::vector<std::exception_ptr> errors(batch.size());
+        try {
+            if (!entry->inference) {
+                load(entry);
+            }
+            run(entry, batch, results, errors);
+        } catch (...) {
+            std::fill(errors.begin(), errors.end(), std::current_exception());
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            batch[i].callback(std::move(results[i]), errors[i]);
+        }
+
+        std::vector<Entry*> started;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entry->running = false;
+            running--;
+            pending -= batch.size();
+            entry->stats.batches++;
+            entry->stats.frames += static_cast<long>(batch.size());
+            // Behind the models already waiting, so a busy model does not
+            // starve the others.
+            if (!entry->queue.empty()) {
+                entry->ready = true;
+                ready.push_back(entry);
+            }
+            started = claimLocked();
+            // Notify under the lock: the destructor may run as soon as it
+            // observes the final decrement, so past this point only start()
+            // may touch the registry, and only with slots claimed.
+            notFull.notify_all();
+        }
+        if (!started.empty()) {
+            start(started);
+        }
+    }
+
+    void run(Entry* entry, const std::vector<Request>& batch, std::vector<std::vector<Detection>>& results, std::vector<std::exception_ptr>& errors) {
+        Inference& inf = *entry->inference;
+        if (batch.size() > 1) {
+            std::vector<cv::Mat> frames;
+            for (const Request& request : batch) {
+                frames.push_back(request.frame);
+            }
+            std::vector<std::vector<CompactDetection>> compact;
+            bool batched = true;
+            try {
+                inf.runInference(frames, compact);
+            } catch (const std::exception& e) {
+                std::cerr << "Model " << entry->name << " runs frame by frame: " << e.what() << std::endl;
+                std::lock_guard<std::mutex> lock(mutex);
+                entry->batchable = false;
+                batched = false;
+            }
+            if (batched) {
+                std::shared_ptr<const ClassTable> classTable = inf.getClassTable();
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    for (const CompactDetection& detection : compact[i]) {
+                        results[i].push_back(toDetection(detection, *classTable));
+                    }
+                }
+                return;
+            }
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            try {
+                results[i] = inf.runInference(batch[i].frame);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    }
+
+    // Runs with entry->running set, so nothing else touches its Inference.
+    // The memory a model adds is measured around its load with the registry
+    // otherwise idle: one load at a time, and no other batch running.
+    void load(Entry* entry) {
+        std::error_code error;
+        size_t fileKb = static_cast<size_t>(std::filesystem::file_size(entry->spec.path, error) / 1024);
+        if (error) {
+            fileKb = 0;
+        }
+
+        std::vector<std::unique_ptr<Inference>> evicted;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Loads waiting their turn hold a slot but run nothing, so the
+            // drain does not wait for them.
+            waitingLoads++;
+            notFull.notify_all();
+            notFull.wait(lock, [this] { return !measuring; });
+            waitingLoads--;
+            measuring = true;
+            notFull.wait(lock, [this] { return running - waitingLoads == 1; });
+
+            size_t estimateKb = entry->memoryKb ? entry->memoryKb : fileKb;
+            const size_t budgetKb = static_cast<size_t>(options.memoryBudgetMb * 1024.0);
+            while (budgetKb > 0 && residentKb + estimateKb > budgetKb) {
+                Entry* victim = nullptr;
+                for (const auto& model : models) {
+                    Entry* candidate = model.second.get();
+                    if (!candidate->running && candidate->loaded && (!victim || candidate->lastUsed < victim->lastUsed)) {
+                        victim = candidate;
+                    }
+                }
+                if (!victim) {
+                    std::cerr << "Loading " << entry->name << " exceeds the model memory budget: the other models are busy" << std::endl;
+                    break;
+                }
+                evicted.push_back(std::move(victim->inference));
+                victim->loaded = false;
+                victim->stats.evictions++;
+                residentKb -= std::min(residentKb, victim->memoryKb);
+            }
+        }
+        // Freed before measuring, so the next model can reuse the memory.
+        evicted.clear();
+
+        ProcessMemory before;
+        bool measured = readProcessMemory(0, before);
+        std::unique_ptr<Inference> inference;
+        double loadMs = 0.0;
+        long grownKb = 0;
+        try {
+            auto begin = std::chrono::steady_clock::now();
+            inference = std::make_unique<Inference>(entry->spec.path, entry->spec.inputSize, entry->spec.classes, false, entry->spec.backend);
+            inference->warmup();
+            loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            ProcessMemory after;
+            grownKb = measured && readProcessMemory(0, after) ? after.ussKb - before.ussKb : 0;
+        } catch (...) {
+            endMeasuring();
+            throw;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entry->inference = std::move(inference);
+            entry->loaded = true;
+            entry->memoryKb = std::max(fileKb, static_cast<size_t>(std::max(0L, grownKb)));
+            residentKb += entry->memoryKb;
+            entry->stats.loads++;
+            entry->stats.lastLoadMs = loadMs;
+        }
+        endMeasuring();
+    }
+
+    // Lets batches start again once a load is measured, or has failed.
+    void endMeasuring() {
+        std::vector<Entry*> started;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            measuring = false;
+            started = claimLocked();
+            notFull.notify_all();
+        }
+        start(started);
+    }
+
+    Options options;
+    std::map<std::string, std::unique_ptr<Entry>> models;
+    std::map<int, Entry*> routes;
+    std::deque<Entry*> ready;
+    int running{0};
+    int waitingLoads{0};
+    bool measuring{false}; // a load is being measured; nothing else may start
+    size_t pending{0};
+    long clock{0};
+    size_t residentKb{0};
+    mutable std::mutex mutex;
+    std::condition_variable notFull;
+    Executor& executor;
+};
+
+#endif // MODELREGISTRY_H
@@ -0,0 +1,415 @@
+// Author: shaoshengsong
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "FrameQueue.h"
+#include "detection.h"
+#include "inference.h"
+#include "topology.h"
+
+// Unit of work flowing through a Pipeline. Sequence numbers are assigned by
+// the source in decode order and are unique per stream.
+struct PipelineItem {
+    int stream{0};
+    long sequence{0};
+    cv::Mat frame;       // full-resolution picture, may be empty (see decode)
+    PreparedFrame input; // network input made by the source, if it made one
+    std::vector<Detection> detections;
+    std::vector<int> trackIds; // parallel to detections once a track stage ran
+};
+
+// Declaration of one stage. Everything the stage kind itself understands
+// (model path, output file, ...) goes into params.
+struct StageConfig {
+    std::string name;
+    std::string kind;
+    std::string input;       // upstream stage, empty for the previously declared one
+    int replicas{1};
+    std::vector<int> cpus;   // replica i is pinned to cpus[i % cpus.size()]
+    int node{-1};            // otherwise pin to this NUMA node's CPUs and memory
+    size_t queueCapacity{8}; // bound of the input queue
+    std::map<std::string, std::string> params;
+
+    std::string param(const std::string& key, const std::string& fallback = "") const {
+        auto it = params.find(key);
+        return it == params.end() ? fallback : it->second;
+    }
+    int intParam(const std::string& key, int fallback) const {
+        auto it = params.find(key);
+        return it == params.end() ? fallback : std::stoi(it->second);
+    }
+    double realParam(const std::string& key, double fallback) const {
+        auto it = params.find(key);
+        return it == params.end() ? fallback : std::stod(it->second);
+    }
+};
+
+// Graph of stages connected by bounded queues. Each stage has one input and
+// may feed several consumers, which all receive every item (they share the
+// frame pixels, so a stage that draws on a fan-out branch should clone).
+// Every replica of a stage is a dedicated thread, so a slow stage is scaled by
+// raising its replica count and pinned with its cpus list or NUMA node.
+//
+// On machines with several NUMA nodes, stages without an explicit placement
+// are laid out per stream: each source and everything downstream of it run on
+// one node (streams spread round-robin), so frames, network replicas and their
+// workspaces are allocated and used on the same socket.
+class Pipeline {
+public:
+    // Sources fill the item and return false at end of stream.
+    using SourceFunction = std::function<bool(PipelineItem& item)>;
+    using StageFunction = std::function<void(PipelineItem& item)>;
+    // Factories run once per replica on that replica's (already pinned)
+    // thread, so per-replica state such as a network is created where it is used.
+    using SourceFactory = std::function<SourceFunction(const StageConfig& config)>;
+    using StageFactory = std::function<StageFunction(const StageConfig& config)>;
+
+    struct StageStats {
+        std::string name;
+        std::string kind;
+        int replicas{1};
+        long items{0};
+        double busyMs{0.0};
+        // Share of the replicas' wall time spent inside the stage function;
+        // the stage closest to 1 is the bottleneck.
+        double utilisation{0.0};
+    };
+
+    void registerSource(const std::string& kind, SourceFactory factory) {
+        sourceFactories[kind] = std::move(factory);
+    }
+
+    // Ordered kinds see each stream's items in sequence order and always run
+    // a single replica.
+    void registerStage(const std::string& kind, StageFactory factory, bool ordered = false) {
+        stageFactories[kind] = std::move(factory);
+        if (ordered) {
+            orderedKinds.insert(kind);
+        }
+    }
+
+    // Enabled by default; has no effect on single-node machines.
+    void setAutoLayout(bool enabled) {
+        autoLayout = enabled;
+    }
+
+    // Stages must be added after the stage they read from, which keeps the
+    // graph acyclic.
+    void addStage(const StageConfig& config) {
+        configs.push_back(config);
+    }
+
+    // Reads the stage list from a cv::FileStorage file (YAML, JSON or XML):
+    //   queueCapacity: 8
+    //   layout: auto        # or none
+    //   stages:
+    //     - { kind: decode, source: "1.mp4" }
+    //     - { kind: infer, replicas: 2, cpus: [2, 3], model: "yolov8s.onnx" }
+    // Keys other than name, kind, input, replicas, cpus, node and
+    // queueCapacity become params.
+    void load(const std::string& path) {
+        cv::FileStorage fs(path, cv::FileStorage::READ);
+        if (!fs.isOpened()) {
+            throw std::runtime_error("Could not open pipeline config: " + path);
+        }
+        int defaultCapacity = fs["queueCapacity"].empty() ? 8 : static_cast<int>(fs["queueCapacity"]);
+        if (!fs["layout"].empty()) {
+            setAutoLayout(static_cast<std::string>(fs["layout"]) != "none");
+        }
+        if (!fs["opencvThreads"].empty()) {
+            // OpenCV's pool is process-wide: it serves every opencv infer replica.
+            cv::setNumThreads(static_cast<int>(fs["opencvThreads"]));
+        }
+        cv::FileNode nodes = fs["stages"];
+        if (!nodes.isSeq()) {
+            throw std::runtime_error("Pipeline config has no stages sequence: " + path);
+        }
+
+        for (cv::FileNode node : nodes) {
+            StageConfig config;
+            config.queueCapacity = defaultCapacity;
+            for (cv::FileNode field : node) {
+                std::string key = field.name();
+                if (key == "name") {
+                    config.name = static_cast<std::string>(field);
+                } else if (key == "kind") {
+                    config.kind = static_cast<std::string>(field);
+                } else if (key == "input") {
+                    config.input = static_cast<std::string>(field);
+                } else if (key == "node") {
+                    config.node = static_cast<int>(field);
+                } else if (key == "replicas") {
+                    config.replicas = static_cast<int>(field);
+                } else if (key == "queueCapacity") {
+                    config.queueCapacity = static_cast<int>(field);
+                } else if (key == "cpus") {
+                    for (cv::FileNode cpu : field) {
+                        config.cpus.push_back(static_cast<int>(cpu));
+                    }
+                } else if (field.isInt()) {
+                    config.params[key] = std::to_string(static_cast<int>(field));
+                } else if (field.isReal()) {
+                    config.params[key] = std::to_string(static_cast<double>(field));
+                } else if (field.isString()) {
+                    config.params[key] = static_cast<std::string>(field);
+                }
+            }
+            addStage(config);
+        }
+    }
+
+    // Runs until every source is exhausted and all queues have drained, then
+    // rethrows the first exception raised by any stage.
+    void run() {
+        build();
+        error = nullptr;
+        failed = false;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (std::unique_ptr<Stage>& stage : stages) {
+            stage->running = stage->config.replicas;
+            for (int replica = 0; replica < stage->config.replicas; ++replica) {
+                threads.emplace_back([this, &stage, replica] { work(*stage, replica); });
+            }
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::vector<StageStats> stats() const {
+        std::vector<StageStats> result;
+        for (const std::unique_ptr<Stage>& stage : stages) {
+            StageStats entry;
+            entry.name = stage->config.name;
+            entry.kind = stage->config.kind;
+            entry.replicas = stage->config.replicas;
+            entry.items = stage->items;
+            entry.busyMs = stage->busyMicros / 1000.0;
+            entry.utilisation = wallMs > 0.0 ? entry.busyMs / (wallMs * entry.replicas) : 0.0;
+            result.push_back(entry);
+        }
+        return result;
+    }
+
+    void printStats(std::ostream& out) const {
+        for (const StageStats& stage : stats()) {
+            out << stage.name << " (" << stage.kind << " x" << stage.replicas << "): "
+                << stage.items << " items, "
+                << (stage.items ? stage.busyMs / stage.items : 0.0) << " ms/item, "
+                << static_cast<int>(stage.utilisation * 100.0) << "% busy" << std::endl;
+        }
+    }
+
+private:
+    struct Stage {
+        StageConfig config;
+        bool source{false};
+        bool ordered{false};
+        int stream{0};
+        std::unique_ptr<ThreadSafeQueue<PipelineItem>> queue; // input, null for sources
+        std::vector<Stage*> consumers;
+        std::atomic<int> running{0};
+        std::atomic<long> items{0};
+        std::atomic<long> busyMicros{0};
+    };
+
+    void build() {
+        stages.clear();
+        std::map<std::string, Stage*> byName;
+        Stage* previous = nullptr;
+        int streams = 0;
+
+        for (const StageConfig& config : configs) {
+            auto stage = std::make_unique<Stage>();
+            stage->config = config;
+            if (stage->config.name.empty()) {
+                stage->config.name = config.kind;
+            }
+            const std::string& name = stage->config.name;
+            if (byName.count(name)) {
+                throw std::runtime_error("Duplicate pipeline stage: " + name);
+            }
+
+            stage->source = sourceFactories.count(config.kind) > 0;
+            if (stage->source) {
+                stage->stream = streams++;
+            } else {
+                if (!stageFactories.count(config.kind)) {
+                    throw std::runtime_error("Unknown pipeline stage kind: " + config.kind);
+                }
+                Stage* upstream = previous;
+                if (!config.input.empty()) {
+                    auto it = byName.find(config.input);
+                    upstream = it == byName.end() ? nullptr : it->second;
+                }
+                if (!upstream) {
+                    throw std::runtime_error("Pipeline stage " + name + " has no input");
+                }
+                upstream->consumers.push_back(stage.get());
+                stage->stream = upstream->stream;
+                stage->ordered = orderedKinds.count(config.kind) > 0;
+                stage->queue = std::make_unique<ThreadSafeQueue<PipelineItem>>(std::max<size_t>(1, config.queueCapacity));
+            }
+
+            if ((stage->source || stage->ordered) && config.replicas > 1) {
+                std::cerr << "Warning: pipeline stage " << name << " runs a single replica." << std::endl;
+                stage->config.replicas = 1;
+            }
+            stage->config.replicas = std::max(1, stage->config.replicas);
+
+            previous = stage.get();
+            byName[name] = previous;
+            stages.push_back(std::move(stage));
+        }
+
+        const CpuTopology& topology = CpuTopology::detect();
+        if (autoLayout && topology.nodeCount() > 1) {
+            for (std::unique_ptr<Stage>& stage : stages) {
+                if (stage->config.cpus.empty() && stage->config.node < 0) {
+                    stage->config.node = stage->stream % topology.nodeCount();
+                }
+            }
+        }
+    }
+
+    void work(Stage& stage, int replica) {
+        // Placement comes first so that everything the replica allocates,
+        // starting with its stage function, is local to where it runs.
+        const std::vector<int>& cpus = stage.config.cpus;
+        if (!cpus.empty()) {
+            int cpu = cpus[replica % cpus.size()];
+            if (pinCurrentThread(cpu)) {
+                preferNodeMemory(CpuTopology::detect().nodeOfCpu(cpu));
+            } else {
+                std::cerr << "Warning: could not pin " << stage.config.name << " to CPU " << cpu << std::endl;
+            }
+        } else if (stage.config.node >= 0 && !bindCurrentThreadToNode(stage.config.node)) {
+            std::cerr << "Warning: could not bind " << stage.config.name << " to NUMA node " << stage.config.node << std::endl;
+        }
+
+        try {
+            if (stage.source) {
+                runSource(stage);
+            } else {
+                runStage(stage);
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+
+        if (--stage.running == 0) {
+            for (Stage* consumer : stage.consumers) {
+                consumer->queue->close();
+            }
+        }
+    }
+
+    void runSource(Stage& stage) {
+        SourceFunction next = sourceFactories.at(stage.config.kind)(stage.config);
+        long sequence = 0;
+        while (!failed) {
+            PipelineItem item;
+            item.stream = stage.stream;
+            item.sequence = sequence;
+
+            auto begin = std::chrono::steady_clock::now();
+            if (!next(item)) {
+                break;
+            }
+            record(stage, begin);
+            sequence++;
+            emit(stage, item);
+        }
+    }
+
+    void runStage(Stage& stage) {
+        StageFunction process = stageFactories.at(stage.config.kind)(stage.config);
+        // Reorder buffer for ordered stages fed by several upstream replicas.
+        std::map<long, PipelineItem> pending;
+        long next = 0;
+
+        PipelineItem item;
+        while (stage.queue->waitAndPop(item)) {
+            if (!stage.ordered) {
+                handle(stage, process, item);
+                continue;
+            }
+            pending.emplace(item.sequence, std::move(item));
+            while (!pending.empty() && pending.begin()->first == next) {
+                handle(stage, process, pending.begin()->second);
+                pending.erase(pending.begin());
+                next++;
+            }
+        }
+    }
+
+    void handle(Stage& stage, const StageFunction& process, PipelineItem& item) {
+        auto begin = std::chrono::steady_clock::now();
+        process(item);
+        record(stage, begin);
+        emit(stage, item);
+    }
+
+    void emit(Stage& stage, const PipelineItem& item) {
+        for (Stage* consumer : stage.consumers) {
+            consumer->queue->push(item);
+        }
+    }
+
+    void record(Stage& stage, std::chrono::steady_clock::time_point begin) {
+        stage.items++;
+        stage.busyMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    // Stops the sources and unblocks every queue so the run winds down.
+    void fail(std::exception_ptr exception) {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = exception;
+            }
+        }
+        failed = true;
+        for (std::unique_ptr<Stage>& stage : stages) {
+            if (stage->queue) {
+                stage->queue->close();
+            }
+        }
+    }
+
+    std::map<std::string, SourceFactory> sourceFactories;
+    std::map<std::string, StageFactory> stageFactories;
+    std::set<std::string> orderedKinds;
+    std::vector<StageConfig> configs;
+    bool autoLayout{true};
+
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::atomic<bool> failed{false};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    double wallMs{0.0};
+};
+
+#endif // PIPELINE_H
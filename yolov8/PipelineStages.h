@@ -0,0 +1,315 @@
+// Author: shaoshengsong
+#ifndef PIPELINESTAGES_H
+#define PIPELINESTAGES_H
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <opencv2/opencv.hpp>
+#include "FramePool.h"
+#include "ffmpeg_reader.h"
+#include "file_io.h"
+#include "yuv_preprocess.h"
+#include "Pipeline.h"
+#include "ResultSaver.h"
+#include "inference.h"
+
+// decode with reader: ffmpeg. libavcodec decodes on several threads and
+// swscale converts each frame straight to the network input size, into pooled
+// buffers the infer stage uses without resizing again.
+inline Pipeline::SourceFunction ffmpegSource(const StageConfig& config, const std::string& source) {
+    FFmpegReaderOptions options;
+    options.decodeThreads = config.intParam("decodeThreads", 0);
+    options.outputSize = cv::Size(config.intParam("width", 640), config.intParam("height", 640));
+    options.letterbox = options.outputSize.width == options.outputSize.height;
+    auto reader = std::make_shared<FFmpegReader>(source, options);
+
+    int framesPerSecond = config.intParam("framesPerSecond", 0);
+    double fps = reader->frameRate();
+    int frameInterval = framesPerSecond > 0 && fps > framesPerSecond ? static_cast<int>(fps / framesPerSecond) : 1;
+    bool fullFrame = config.intParam("fullFrame", 1) != 0;
+    auto frameCount = std::make_shared<long>(0);
+    bool yuv = config.intParam("yuv", 0) != 0;
+    auto inputPool = std::make_shared<FramePool>(config.intParam("poolSize", 16));
+    auto framePool = std::make_shared<FramePool>(config.intParam("poolSize", 16));
+
+    return [reader, options, frameInterval, fullFrame, yuv, frameCount, inputPool, framePool](PipelineItem& item) {
+        while ((*frameCount)++ % frameInterval != 0) {
+            if (!reader->skip()) {
+                return false;
+            }
+        }
+        cv::Size size = reader->frameSize();
+        cv::Mat frame = fullFrame ? framePool->acquire(size.height, size.width, CV_8UC3) : cv::Mat();
+        double timestamp = 0.0;
+        const cv::Size& model = options.outputSize;
+        if (yuv) {
+            // A pooled 3H x W float buffer viewed as the 1x3xHxW blob.
+            cv::Mat blob = inputPool->acquire(3 * model.height, model.width, CV_32F).reshape(1, { 1, 3, model.height, model.width });
+            YuvImage image;
+            if (!reader->readYuv(image, fullFrame ? &frame : nullptr, timestamp)) {
+                return false;
+            }
+            yuvToBlob(image, model, options.letterbox, blob);
+            item.input = { cv::Mat(), cv::Size(image.width, image.height), blob };
+        } else {
+            cv::Mat input = inputPool->acquire(model.height, model.width, CV_8UC3);
+            if (!reader->read(input, fullFrame ? &frame : nullptr, timestamp)) {
+                return false;
+            }
+            item.input = { input, reader->frameSize() };
+        }
+        item.frame = frame;
+        return true;
+    };
+}
+
+// Built-in stage kinds:
+//   decode      source: path (file or camera index), framesPerSecond (0 = every frame),
+//               poolSize: recycled frame buffers (should cover the frames in flight),
+//               reader: opencv or ffmpeg. The ffmpeg reader decodes on
+//               decodeThreads threads (0 = per core) and scales straight to
+//               width x height (default 640x640, the infer stage's input) as the
+//               network input; fullFrame: 0 skips the full-resolution copy when
+//               nothing renders or encodes; yuv: 1 builds the network blob
+//               straight from the decoder's YUV planes instead
+//   preprocess  width, height: resize frames before inference (no-op if unset)
+//   infer       model, classes, width, height, cuda, backend, threads; intra-op
+//               threads are kept on the stage's CPUs or NUMA node
+//   postprocess minConfidence, classes (comma separated ids to keep)
+//   track       iou: greedy IoU matching against the previous frame (ordered)
+//   render      draws boxes on the frame (if there is one)
+//   encode      path, fps, fourcc (ordered; needs full frames)
+//   sink        print: log the detection count of every frame
+inline void registerBuiltinStages(Pipeline& pipeline) {
+    pipeline.registerSource("decode", [](const StageConfig& config) -> Pipeline::SourceFunction {
+        std::string source = config.param("source", "1.mp4");
+        if (config.param("reader", "opencv") == "ffmpeg") {
+            return ffmpegSource(config, source);
+        }
+        auto cap = std::make_shared<cv::VideoCapture>();
+        if (!source.empty() && source.find_first_not_of("0123456789") == std::string::npos) {
+            cap->open(std::stoi(source));
+        } else {
+            cap->open(source);
+        }
+        if (!cap->isOpened()) {
+            throw std::runtime_error("Could not open video source " + source);
+        }
+
+        int framesPerSecond = config.intParam("framesPerSecond", 0);
+        double fps = cap->get(cv::CAP_PROP_FPS);
+        int frameInterval = framesPerSecond > 0 && fps > framesPerSecond ? static_cast<int>(fps / framesPerSecond) : 1;
+        auto frameCount = std::make_shared<long>(0);
+
+        // Decoding straight into pooled buffers keeps frame memory on this
+        // (pinned) thread's node instead of wherever malloc last freed it.
+        auto pool = std::make_shared<FramePool>(config.intParam("poolSize", 16));
+        int width = static_cast<int>(cap->get(cv::CAP_PROP_FRAME_WIDTH));
+        int height = static_cast<int>(cap->get(cv::CAP_PROP_FRAME_HEIGHT));
+
+        return [cap, frameInterval, frameCount, pool, width, height](PipelineItem& item) {
+            cv::Mat frame = width > 0 && height > 0 ? pool->acquire(height, width, CV_8UC3) : cv::Mat();
+            while (cap->read(frame)) {
+                if ((*frameCount)++ % frameInterval == 0) {
+                    item.frame = frame;
+                    return true;
+                }
+            }
+            return false;
+        };
+    });
+
+    pipeline.registerStage("preprocess", [](const StageConfig& config) -> Pipeline::StageFunction {
+        cv::Size size(config.intParam("width", 0), config.intParam("height", 0));
+        return [size](PipelineItem& item) {
+            if (size.width > 0 && size.height > 0 && item.frame.size() != size) {
+                cv::Mat resized;
+                cv::resize(item.frame, resized, size, 0, 0, cv::INTER_AREA);
+                item.frame = resized;
+            }
+        };
+    });
+
+    pipeline.registerStage("infer", [](const StageConfig& config) -> Pipeline::StageFunction {
+        BackendOptions options;
+        options.type = backendTypeFromName(config.param("backend", "opencv"));
+        options.intraOpThreads = config.intParam("threads", 0);
+        options.cpus = config.cpus;
+        if (options.cpus.empty() && config.node >= 0 && config.node < CpuTopology::detect().nodeCount()) {
+            options.cpus = CpuTopology::detect().nodeCpus[config.node];
+        }
+        options.modelCacheDirectory = config.param("modelCache");
+        auto inf = std::make_shared<Inference>(config.param("model", "yolov8s.onnx"),
+                                               cv::Size(config.intParam("width", 640), config.intParam("height", 640)),
+                                               config.param("classes", "classes.txt"),
+                                               config.intParam("cuda", 0) != 0, options);
+        // Warm up while the graph is still being built, before frames flow.
+        if (config.intParam("warmup", 1) != 0) {
+            inf->warmup();
+        }
+        return [inf](PipelineItem& item) {
+            bool prepared = !item.input.image.empty() || !item.input.blob.empty();
+            item.detections = prepared ? inf->runInference(item.input) : inf->runInference(item.frame);
+        };
+    });
+
+    pipeline.registerStage("postprocess", [](const StageConfig& config) -> Pipeline::StageFunction {
+        float minConfidence = static_cast<float>(config.realParam("minConfidence", 0.0));
+        std::vector<int> keep;
+        std::stringstream classes(config.param("classes"));
+        for (std::string id; std::getline(classes, id, ',');) {
+            keep.push_back(std::stoi(id));
+        }
+        return [minConfidence, keep](PipelineItem& item) {
+            std::vector<Detection> filtered;
+            for (const Detection& detection : item.detections) {
+                bool classKept = keep.empty() || std::find(keep.begin(), keep.end(), detection.class_id) != keep.end();
+                if (classKept && detection.confidence >= minConfidence) {
+                    filtered.push_back(detection);
+                }
+            }
+            item.detections.swap(filtered);
+        };
+    });
+
+    pipeline.registerStage("track", [](const StageConfig& config) -> Pipeline::StageFunction {
+        struct Track {
+            int id;
+            int classId;
+            cv::Rect box;
+        };
+        auto previous = std::make_shared<std::vector<Track>>();
+        auto nextId = std::make_shared<int>(0);
+        float minIou = static_cast<float>(config.realParam("iou", 0.3));
+
+        return [previous, nextId, minIou](PipelineItem& item) {
+            std::vector<Track> current;
+            std::vector<bool> taken(previous->size(), false);
+            item.trackIds.clear();
+            for (const Detection& detection : item.detections) {
+                int best = -1;
+                float bestIou = minIou;
+                for (size_t i = 0; i < previous->size(); ++i) {
+                    const Track& track = (*previous)[i];
+                    if (taken[i] || track.classId != detection.class_id) {
+                        continue;
+                    }
+                    float overlap = static_cast<float>((track.box & detection.box).area());
+                    float iou = overlap / (track.box.area() + detection.box.area() - overlap);
+                    if (iou >= bestIou) {
+                        bestIou = iou;
+                        best = static_cast<int>(i);
+                    }
+                }
+                int id = best >= 0 ? (*previous)[best].id : (*nextId)++;
+                if (best >= 0) {
+                    taken[best] = true;
+                }
+                item.trackIds.push_back(id);
+                current.push_back({id, detection.class_id, detection.box});
+            }
+            previous->swap(current);
+        };
+    }, true);
+
+    pipeline.registerStage("render", [](const StageConfig&) -> Pipeline::StageFunction {
+        return [](PipelineItem& item) {
+            if (item.frame.empty()) {
+                return;
+            }
+            FrameResult frameResult = { item.frame, std::move(item.detections) };
+            ResultSaver::drawDetections(frameResult);
+            item.detections = std::move(frameResult.detections);
+        };
+    });
+
+    pipeline.registerStage("encode", [](const StageConfig& config) -> Pipeline::StageFunction {
+        // Opened on the first frame, once the frame size is known.
+        auto writer = std::make_shared<cv::VideoWriter>();
+        std::string path = config.param("path", "output.avi");
+        std::string fourcc = config.param("fourcc", "MJPG");
+        double fps = config.realParam("fps", 25.0);
+        if (fourcc.size() != 4) {
+            throw std::runtime_error("encode: fourcc must have four characters");
+        }
+
+        return [writer, path, fourcc, fps](PipelineItem& item) {
+            if (item.frame.empty()) {
+                throw std::runtime_error("encode: the source does not keep full frames (fullFrame: 0)");
+            }
+            if (!writer->isOpened()) {
+                int code = cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]);
+                if (!writer->open(path, code, fps, item.frame.size())) {
+                    throw std::runtime_error("Could not open the output video file " + path);
+                }
+            }
+            writer->write(item.frame);
+        };
+    }, true);
+
+    // One JPEG per detection, cut from the full frame and written through the
+    // asynchronous I/O layer. Goes before render, which draws on the frame.
+    pipeline.registerStage("crops", [](const StageConfig& config) -> Pipeline::StageFunction {
+        std::string directory = config.param("dir", "crops");
+        int quality = config.intParam("quality", 90);
+        std::filesystem::create_directories(directory);
+
+        return [directory, quality](PipelineItem& item) {
+            if (item.detections.empty()) {
+                return;
+            }
+            if (item.frame.empty()) {
+                throw std::runtime_error("crops: the source does not keep full frames (fullFrame: 0)");
+            }
+            const cv::Rect bounds(0, 0, item.frame.cols, item.frame.rows);
+            for (size_t i = 0; i < item.detections.size(); ++i) {
+                cv::Rect box = item.detections[i].box & bounds;
+                if (box.area() == 0) {
+                    continue;
+                }
+                std::vector<uint8_t> encoded;
+                cv::imencode(".jpg", item.frame(box), encoded, { cv::IMWRITE_JPEG_QUALITY, quality });
+                std::string className = item.detections[i].className;
+                std::replace(className.begin(), className.end(), ' ', '_');
+                std::string path = directory + "/" + std::to_string(item.stream) + "_" + std::to_string(item.sequence) + "_"
+                                   + std::to_string(i) + "_" + className + ".jpg";
+                FileIO::instance().write(path, std::move(encoded), false, [path](const std::string& error) {
+                    if (!error.empty()) {
+                        std::cerr << "Warning: crops: " << error << std::endl;
+                    }
+                });
+            }
+        };
+    });
+
+    // Detection log, one CSV row per detection, appended in frame order
+    // without blocking the pipeline on the write.
+    pipeline.registerStage("log", [](const StageConfig& config) -> Pipeline::StageFunction {
+        auto log = std::make_shared<AsyncLogWriter>(config.param("path", "detections.csv"));
+        log->write("stream,frame,class,confidence,x,y,width,height\n");
+        return [log](PipelineItem& item) {
+            std::ostringstream rows;
+            for (const Detection& detection : item.detections) {
+                rows << item.stream << ',' << item.sequence << ',' << detection.className << ',' << detection.confidence << ','
+                     << detection.box.x << ',' << detection.box.y << ',' << detection.box.width << ',' << detection.box.height << '\n';
+            }
+            if (rows.tellp() > 0) {
+                log->write(rows.str());
+            }
+        };
+    }, true);
+
+    pipeline.registerStage("sink", [](const StageConfig& config) -> Pipeline::StageFunction {
+        bool print = config.intParam("print", 0) != 0;
+        return [print](PipelineItem& item) {
+            if (print) {
+                std::cout << "Stream " << item.stream << " frame " << item.sequence
+                          << ": " << item.detections.size() << " detections" << std::endl;
+            }
+        };
+    });
+}
+
+#endif // PIPELINESTAGES_H
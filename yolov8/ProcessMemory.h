@@ -0,0 +1,48 @@
+// Author: shaoshengsong
+#ifndef PROCESSMEMORY_H
+#define PROCESSMEMORY_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Memory of one process in kB. uss (pages only this process maps) is what a
+// worker really adds; pss splits shared pages between their users.
+struct ProcessMemory {
+    long rssKb{0};
+    long pssKb{0};
+    long ussKb{0};
+};
+
+// Reads /proc/<pid>/smaps_rollup (pid 0: this process), or sums
+// /proc/<pid>/smaps on kernels older than 4.14. Returns false if neither can
+// be read, e.g. on systems without procfs.
+inline bool readProcessMemory(long pid, ProcessMemory& memory) {
+    std::string base = "/proc/" + (pid > 0 ? std::to_string(pid) : std::string("self"));
+    std::ifstream smaps(base + "/smaps_rollup");
+    if (!smaps) {
+        smaps.open(base + "/smaps");
+    }
+    if (!smaps) {
+        return false;
+    }
+    memory = ProcessMemory();
+    for (std::string line; std::getline(smaps, line);) {
+        std::istringstream fields(line);
+        std::string key;
+        long kb = 0;
+        if (!(fields >> key >> kb)) {
+            continue;
+        }
+        if (key == "Rss:") {
+            memory.rssKb += kb;
+        } else if (key == "Pss:") {
+            memory.pssKb += kb;
+        } else if (key == "Private_Clean:" || key == "Private_Dirty:") {
+            memory.ussKb += kb;
+        }
+    }
+    return true;
+}
+
+#endif // PROCESSMEMORY_H
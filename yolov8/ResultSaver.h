@@ -5,12 +5,18 @@
 #include <opencv2/opencv.hpp>
 #include "FrameQueue.h"
 #include "FrameResult.h"
+#include "LatencyMonitor.h"
 
 class ResultSaver {
 public:
     ResultSaver(ThreadSafeQueue<FrameResult>& resultQueue, const std::string& outputFilePath, int fps, cv::Size frameSize)
         : resultQueue(resultQueue), outputFilePath(outputFilePath), fps(fps), frameSize(frameSize) {}
 
+    // Records glass-to-glass latency (capture to written frame) per result.
+    void setLatencyMonitor(LatencyMonitor& monitor) {
+        latencyMonitor = &monitor;
+    }
+
     void operator()() {
         cv::VideoWriter writer(outputFilePath, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, frameSize);
         if (!writer.isOpened()) {
@@ -21,36 +27,69 @@ public:
         while (true) {
             FrameResult frameResult;
             if (resultQueue.waitAndPop(frameResult)) {
-                cv::Mat frame = frameResult.frame;
-                std::vector<Detection> output = frameResult.detections;
-
-                int detections = output.size();
-                std::cout << "Number of detections:" << detections << std::endl;
-
-                for (int i = 0; i < detections; ++i) {
-                    Detection detection = output[i];
+                int detections = frameResult.detections.size();
+                std::cout << "Number of detections:" << detections;
+                if (frameResult.timestamp >= 0.0) {
+                    std::cout << " at " << cv::format("%.3f", frameResult.timestamp) << " s";
+                }
+                std::cout << std::endl;
 
-                    cv::Rect box = detection.box;
-                    cv::Scalar color = detection.color;
+                drawDetections(frameResult);
+                writer.write(frameResult.frame);
+                if (latencyMonitor) {
+                    latencyMonitor->recordDelivered(frameResult.captured);
+                }
+            } else {
+                break;
+            }
+        }
 
-                    cv::rectangle(frame, box, color, 2);
+        writer.release();
+        std::cout << "Video writing completed." << std::endl;
+    }
 
-                    std::string classString = detection.className + ' ' + std::to_string(detection.confidence).substr(0, 4);
-                    cv::Size textSize = cv::getTextSize(classString, cv::FONT_HERSHEY_DUPLEX, 1, 2, 0);
-                    cv::Rect textBox(box.x, box.y - 40, textSize.width + 10, textSize.height + 20);
+#ifdef YOLOV8_COROUTINES
+    Task run(CoroExecutor& executor) {
+        co_await executor.schedule();
 
-                    cv::rectangle(frame, textBox, color, cv::FILLED);
-                    cv::putText(frame, classString, cv::Point(box.x + 5, box.y - 10), cv::FONT_HERSHEY_DUPLEX, 1, cv::Scalar(0, 0, 0), 2, 0);
-                }
+        cv::VideoWriter writer(outputFilePath, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, frameSize);
+        if (!writer.isOpened()) {
+            std::cerr << "Error: Could not open the output video file for writing." << std::endl;
+            co_return;
+        }
 
-                writer.write(frame);
-            } else {
+        while (true) {
+            std::optional<FrameResult> frameResult = co_await resultQueue.pop(executor);
+            if (!frameResult) {
                 break;
             }
+            drawDetections(*frameResult);
+            writer.write(frameResult->frame);
+            if (latencyMonitor) {
+                latencyMonitor->recordDelivered(frameResult->captured);
+            }
         }
 
         writer.release();
-        std::cout << "Video writing completed." << std::endl;
+        std::cout << outputFilePath << ": writing completed." << std::endl;
+    }
+#endif
+
+    static void drawDetections(FrameResult& frameResult) {
+        cv::Mat& frame = frameResult.frame;
+        for (const Detection& detection : frameResult.detections) {
+            cv::Rect box = detection.box;
+            cv::Scalar color = detection.color;
+
+            cv::rectangle(frame, box, color, 2);
+
+            std::string classString = detection.className + ' ' + std::to_string(detection.confidence).substr(0, 4);
+            cv::Size textSize = cv::getTextSize(classString, cv::FONT_HERSHEY_DUPLEX, 1, 2, 0);
+            cv::Rect textBox(box.x, box.y - 40, textSize.width + 10, textSize.height + 20);
+
+            cv::rectangle(frame, textBox, color, cv::FILLED);
+            cv::putText(frame, classString, cv::Point(box.x + 5, box.y - 10), cv::FONT_HERSHEY_DUPLEX, 1, cv::Scalar(0, 0, 0), 2, 0);
+        }
     }
 
 private:
@@ -58,6 +97,7 @@ private:
     std::string outputFilePath;
     int fps;
     cv::Size frameSize;
+    LatencyMonitor* latencyMonitor{nullptr};
 };
 
 #endif // RESULTSAVER_H
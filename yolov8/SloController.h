@@ -0,0 +1,199 @@
+// Author: shaoshengsong
+#ifndef SLOCONTROLLER_H
+#define SLOCONTROLLER_H
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "inference.h"
+
+// One setting of the three knobs the controller turns.
+struct OperatingPoint {
+    int tier{0};         // index into modelTiers, 0 is the most accurate
+    int resolution{640}; // square network input
+    int sampleStride{1}; // process every n-th captured frame
+};
+
+// Closed-loop controller that keeps a stream's p99 latency (capture to
+// detections) under a target. Quality levels are ordered from best to
+// cheapest: every resolution of the first model tier, then of the next tier,
+// then sampling strides 2..maxSampleStride at the cheapest setting. After each
+// window of frames it steps one level down when the p99 is over target or the
+// frame queue backs up, and one level up only after recoverWindows consecutive
+// windows below recoverFraction of the target (hysteresis). Every change is
+// written to the log.
+//
+// Not thread-safe: all calls come from the thread that runs inference.
+class SloController {
+public:
+    using Factory = std::function<std::unique_ptr<Inference>(const std::string& modelPath, const cv::Size& inputShape)>;
+
+    struct Options {
+        double targetP99Ms{200.0};
+        double recoverFraction{0.6};
+        std::vector<std::string> modelTiers;
+        std::vector<int> resolutions{640, 480, 320};
+        int maxSampleStride{4};
+        int windowFrames{30};
+        int recoverWindows{3};
+        size_t maxQueueDepth{4};
+    };
+
+    SloController(const Options& options, Factory factory, std::ostream& log = std::clog)
+        : options(options), factory(std::move(factory)), log(log) {
+        if (this->options.modelTiers.empty()) {
+            throw std::runtime_error("SloController needs at least one model tier");
+        }
+        if (this->options.resolutions.empty()) {
+            this->options.resolutions.push_back(640);
+        }
+        this->options.maxSampleStride = std::max(1, this->options.maxSampleStride);
+        this->options.windowFrames = std::max(1, this->options.windowFrames);
+
+        int modelLevels = static_cast<int>(this->options.modelTiers.size() * this->options.resolutions.size());
+        usable.assign(modelLevels + this->options.maxSampleStride - 1, true);
+    }
+
+    // False when the frame is skipped at the current sampling rate. The stride
+    // applies to the frames offered here, not to their index in the file: the
+    // reader may already queue only every n-th frame, and a stride over those
+    // indices would skip nothing.
+    bool sample() {
+        return offered++ % point(level).sampleStride == 0;
+    }
+
+    // Network for the current operating point, built or resized on demand.
+    // Levels the model cannot run at are marked unusable and skipped.
+    Inference& inference() {
+        while (true) {
+            OperatingPoint target = point(level);
+            try {
+                std::unique_ptr<Inference>& tier = tiers[target.tier];
+                cv::Size shape(target.resolution, target.resolution);
+                if (!tier) {
+                    tier = factory(options.modelTiers[target.tier], shape);
+                } else {
+                    tier->setInputShape(shape);
+                }
+                return *tier;
+            } catch (const std::exception& e) {
+                log << "SLO: level " << level << " unusable (" << e.what() << ")" << std::endl;
+                usable[level] = false;
+                int fallback = nextUsable(level, +1);
+                if (fallback == level) {
+                    fallback = nextUsable(level, -1);
+                }
+                if (fallback == level) {
+                    throw;
+                }
+                level = fallback;
+            }
+        }
+    }
+
+    // Reports one processed frame: time spent queued, in inference, and from
+    // capture to detections; queueDepth is the backlog behind it.
+    void record(double queueMs, double inferenceMs, double totalMs, size_t queueDepth) {
+        window.push_back(totalMs);
+        queueMsSum += queueMs;
+        inferenceMsSum += inferenceMs;
+        maxDepth = std::max(maxDepth, queueDepth);
+        if (static_cast<int>(window.size()) >= options.windowFrames) {
+            decide();
+        }
+    }
+
+    OperatingPoint current() const {
+        return point(level);
+    }
+
+private:
+    void decide() {
+        std::sort(window.begin(), window.end());
+        double p99 = window[std::min(window.size() - 1, static_cast<size_t>(0.99 * window.size()))];
+        double queueMean = queueMsSum / window.size();
+        double inferenceMean = inferenceMsSum / window.size();
+
+        std::string reason;
+        int next = level;
+        if (p99 > options.targetP99Ms || maxDepth > options.maxQueueDepth) {
+            healthyWindows = 0;
+            next = nextUsable(level, +1);
+            reason = p99 > options.targetP99Ms ? "p99 over target" : "queue backing up";
+        } else if (p99 < options.recoverFraction * options.targetP99Ms) {
+            if (++healthyWindows >= options.recoverWindows) {
+                healthyWindows = 0;
+                next = nextUsable(level, -1);
+                reason = "headroom";
+            }
+        } else {
+            healthyWindows = 0;
+        }
+
+        if (next != level) {
+            OperatingPoint from = point(level);
+            OperatingPoint to = point(next);
+            log << "SLO: " << reason << " (p99 " << p99 << " ms, target " << options.targetP99Ms
+                << " ms, queue " << queueMean << " ms, inference " << inferenceMean << " ms, depth " << maxDepth << "): "
+                << describe(from) << " -> " << describe(to) << std::endl;
+            level = next;
+        }
+
+        window.clear();
+        queueMsSum = 0.0;
+        inferenceMsSum = 0.0;
+        maxDepth = 0;
+    }
+
+    OperatingPoint point(int index) const {
+        int resolutions = static_cast<int>(options.resolutions.size());
+        int modelLevels = static_cast<int>(options.modelTiers.size()) * resolutions;
+        OperatingPoint result;
+        int modelLevel = std::min(index, modelLevels - 1);
+        if (index >= modelLevels) {
+            // Sampling levels run at the cheapest model level that works.
+            while (modelLevel > 0 && !usable[modelLevel]) {
+                modelLevel--;
+            }
+        }
+        result.tier = modelLevel / resolutions;
+        result.resolution = options.resolutions[modelLevel % resolutions];
+        result.sampleStride = 1 + std::max(0, index - (modelLevels - 1));
+        return result;
+    }
+
+    // Closest usable level in the given direction, or from if there is none.
+    int nextUsable(int from, int direction) const {
+        for (int candidate = from + direction; candidate >= 0 && candidate < static_cast<int>(usable.size()); candidate += direction) {
+            if (usable[candidate]) {
+                return candidate;
+            }
+        }
+        return from;
+    }
+
+    std::string describe(const OperatingPoint& p) const {
+        return options.modelTiers[p.tier] + " " + std::to_string(p.resolution) + "px 1/" + std::to_string(p.sampleStride);
+    }
+
+    Options options;
+    Factory factory;
+    std::ostream& log;
+    std::map<int, std::unique_ptr<Inference>> tiers;
+    std::vector<bool> usable;
+    int level{0};
+    int healthyWindows{0};
+    long offered{0};
+
+    std::vector<double> window;
+    double queueMsSum{0.0};
+    double inferenceMsSum{0.0};
+    size_t maxDepth{0};
+};
+
+#endif // SLOCONTROLLER_H
@@ -0,0 +1,228 @@
+// Author: shaoshengsong
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProcessMemory.h"
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Prefork supervisor: whatever the caller set up before run() (a loaded and
+// warmed Inference above all) is inherited by every worker process, whose
+// pages stay shared copy-on-write until written. Worker w gets the streams at
+// indices w, w + workers, ...; one that crashes (signal or non-zero exit) is
+// forked again from the supervisor, with back-off, up to maxRestarts times,
+// and starts its streams over. POSIX only.
+//
+// Fork keeps only the calling thread, so nothing with threads of its own may
+// be running in the supervisor at run(): keep OpenCV sequential
+// (cv::setNumThreads(0)) and leave the Executor uncreated until the worker.
+class Supervisor {
+public:
+    // Runs in the worker process; its return value is the exit status.
+    using WorkerFunction = std::function<int(int worker, const std::vector<std::string>& streams)>;
+
+    struct Options {
+        int workers{2};
+        int maxRestarts{5};
+        double reportSeconds{10.0}; // memory report interval, 0 for none
+    };
+
+    struct WorkerState {
+        long pid{-1};
+        std::vector<std::string> streams;
+        int restarts{0};
+        bool finished{false};
+        std::chrono::steady_clock::time_point restartAt{};
+        ProcessMemory last{};
+        long peakUssKb{0};
+    };
+
+    Supervisor(const std::vector<std::string>& streams, const Options& options, WorkerFunction work)
+        : options(options), work(std::move(work)) {
+        int count = std::max(1, std::min<int>(options.workers, static_cast<int>(streams.size())));
+        workers.resize(count);
+        for (size_t i = 0; i < streams.size(); ++i) {
+            workers[i % count].streams.push_back(streams[i]);
+        }
+    }
+
+    // Forks the workers and supervises them until all have finished, or until
+    // SIGINT/SIGTERM, which is passed on to them. Returns 0 when every worker
+    // finished cleanly.
+    int run() {
+#ifdef _WIN32
+        throw std::runtime_error("The prefork supervisor needs fork(); not available on Windows");
+#else
+        stopRequested() = 0;
+        std::signal(SIGINT, [](int) { stopRequested() = 1; });
+        std::signal(SIGTERM, [](int) { stopRequested() = 1; });
+
+        for (size_t w = 0; w < workers.size(); ++w) {
+            spawn(static_cast<int>(w));
+        }
+
+        int failures = 0;
+        bool stopping = false;
+        auto nextReport = std::chrono::steady_clock::now() + reportInterval();
+        auto nextSample = std::chrono::steady_clock::now();
+        while (std::any_of(workers.begin(), workers.end(), [](const WorkerState& state) { return !state.finished; })) {
+            if (stopRequested() && !stopping) {
+                stopping = true;
+                for (WorkerState& state : workers) {
+                    if (state.pid > 0) {
+                        ::kill(static_cast<pid_t>(state.pid), SIGTERM);
+                    }
+                }
+            }
+
+            int status = 0;
+            pid_t pid = ::waitpid(-1, &status, WNOHANG);
+            if (pid > 0) {
+                failures += reap(pid, status, stopping);
+                continue;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            for (size_t w = 0; w < workers.size(); ++w) {
+                WorkerState& state = workers[w];
+                if (!state.finished && state.pid < 0 && now >= state.restartAt) {
+                    if (stopping) {
+                        state.finished = true;
+                    } else {
+                        spawn(static_cast<int>(w));
+                    }
+                }
+            }
+            // Reading smaps walks the page tables, so not on every tick.
+            if (now >= nextSample) {
+                sample();
+                nextSample = now + std::chrono::seconds(1);
+            }
+            if (options.reportSeconds > 0.0 && now >= nextReport) {
+                printMemory(std::cout);
+                nextReport = now + reportInterval();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        return failures == 0 ? 0 : 1;
+#endif
+    }
+
+    // Unique, proportional and resident memory of the supervisor and of each
+    // running worker, plus each worker's peak unique memory so far.
+    void printMemory(std::ostream& out) const {
+        ProcessMemory own;
+        if (readProcessMemory(0, own)) {
+            out << "Supervisor: RSS " << own.rssKb / 1024 << " MB, PSS " << own.pssKb / 1024 << " MB, USS " << own.ussKb / 1024 << " MB" << std::endl;
+        }
+        for (size_t w = 0; w < workers.size(); ++w) {
+            const WorkerState& state = workers[w];
+            out << "Worker " << w << " (" << state.streams.size() << " streams, " << state.restarts << " restarts): ";
+            if (state.pid > 0) {
+                out << "pid " << state.pid << ", RSS " << state.last.rssKb / 1024 << " MB, PSS " << state.last.pssKb / 1024
+                    << " MB, USS " << state.last.ussKb / 1024 << " MB";
+            } else {
+                out << (state.finished ? "finished" : "restarting");
+            }
+            out << ", peak USS " << state.peakUssKb / 1024 << " MB" << std::endl;
+        }
+    }
+
+    const std::vector<WorkerState>& states() const { return workers; }
+
+private:
+#ifndef _WIN32
+    static volatile std::sig_atomic_t& stopRequested() {
+        static volatile std::sig_atomic_t flag = 0;
+        return flag;
+    }
+
+    std::chrono::steady_clock::duration reportInterval() const {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(std::max(0.1, options.reportSeconds)));
+    }
+
+    void spawn(int worker) {
+        WorkerState& state = workers[worker];
+        std::cout.flush();
+        std::cerr.flush();
+        pid_t pid = ::fork();
+        if (pid < 0) {
+            throw std::runtime_error("fork failed for worker " + std::to_string(worker));
+        }
+        if (pid == 0) {
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+            int code = 1;
+            try {
+                code = work(worker, state.streams);
+            } catch (const std::exception& e) {
+                std::cerr << "Worker " << worker << ": " << e.what() << std::endl;
+            }
+            std::cout.flush();
+            std::cerr.flush();
+            // Skips the supervisor's static destructors and atexit handlers.
+            ::_exit(code);
+        }
+        state.pid = pid;
+        std::cout << "Worker " << worker << " started, pid " << pid << ", " << state.streams.size() << " streams" << std::endl;
+    }
+
+    // Returns 1 if the worker failed for good.
+    int reap(pid_t pid, int status, bool stopping) {
+        auto it = std::find_if(workers.begin(), workers.end(), [pid](const WorkerState& state) { return state.pid == pid; });
+        if (it == workers.end()) {
+            return 0;
+        }
+        WorkerState& state = *it;
+        int worker = static_cast<int>(it - workers.begin());
+        state.pid = -1;
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            std::cout << "Worker " << worker << " finished" << std::endl;
+            state.finished = true;
+            return 0;
+        }
+        std::string reason = WIFSIGNALED(status) ? "signal " + std::to_string(WTERMSIG(status))
+                                                 : "exit status " + std::to_string(WEXITSTATUS(status));
+        if (stopping || state.restarts >= options.maxRestarts) {
+            std::cerr << "Worker " << worker << " ended (" << reason << "), not restarted" << std::endl;
+            state.finished = true;
+            return stopping ? 0 : 1;
+        }
+        // Back-off doubles from 0.5 s up to 30 s so a worker that dies on
+        // start does not spin.
+        double delay = std::min(30.0, 0.5 * (1 << std::min(state.restarts, 6)));
+        state.restarts++;
+        state.restartAt = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(delay));
+        std::cerr << "Worker " << worker << " crashed (" << reason << "), restart " << state.restarts << " in " << delay << " s" << std::endl;
+        return 0;
+    }
+
+    void sample() {
+        for (WorkerState& state : workers) {
+            if (state.pid > 0 && readProcessMemory(state.pid, state.last)) {
+                state.peakUssKb = std::max(state.peakUssKb, state.last.ussKb);
+            }
+        }
+    }
+#endif
+
+    Options options;
+    WorkerFunction work;
+    std::vector<WorkerState> workers;
+};
+
+#endif // SUPERVISOR_H
@@ -0,0 +1,165 @@
+// Author: shaoshengsong
+#ifndef TWOPASSANALYZER_H
+#define TWOPASSANALYZER_H
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "ffmpeg_reader.h"
+#include "inference.h"
+
+// Detections of one analysed frame.
+struct AnalysedFrame {
+    long index{0};         // frame number in the file
+    double timestamp{0.0}; // seconds into the video
+    int pass{1};           // 1 = coarse scan, 2 = fine re-analysis
+    std::vector<Detection> detections;
+};
+
+// Coarse-to-fine analysis of a video file. Pass 1 runs the network over the
+// whole file at a low rate. Each pass-1 detection of a trigger class opens a
+// time window around it; overlapping windows are merged and pass 2 seeks to
+// every window and analyses it at the fine rate. The result lists the frames
+// of both passes in file order, each frame once.
+class TwoPassAnalyzer {
+public:
+    struct Options {
+        double coarseFps{1.0};
+        double fineFps{0.0};             // 0 analyses every frame of a window
+        double secondsBefore{2.0};
+        double secondsAfter{2.0};
+        std::vector<int> triggerClasses; // empty: any class triggers
+        float triggerConfidence{0.5f};
+        // Pass 1 over keyframes only instead of every 1/coarseFps seconds
+        // (needs YOLOV8_WITH_FFMPEG).
+        bool coarseKeyframes{false};
+    };
+
+    // Time range re-analysed by pass 2, in seconds.
+    struct Window {
+        double begin;
+        double end;
+    };
+
+    TwoPassAnalyzer(Inference& inf, const Options& options) : inf(inf), options(options) {}
+
+    std::vector<AnalysedFrame> analyse(const std::string& videoFilePath) {
+        cv::VideoCapture cap(videoFilePath);
+        if (!cap.isOpened()) {
+            throw std::runtime_error("Could not open video file " + videoFilePath);
+        }
+        fps = cap.get(cv::CAP_PROP_FPS);
+        if (fps <= 0) {
+            throw std::runtime_error("Video file has no frame rate: " + videoFilePath);
+        }
+
+        std::map<long, AnalysedFrame> frames;
+        if (options.coarseKeyframes) {
+            scanKeyframes(videoFilePath, frames);
+        } else {
+            scan(cap, frames);
+        }
+
+        windows = triggerWindows(frames);
+        for (const Window& window : windows) {
+            refine(cap, window, frames);
+        }
+
+        std::vector<AnalysedFrame> result;
+        result.reserve(frames.size());
+        for (auto& entry : frames) {
+            result.push_back(std::move(entry.second));
+        }
+        return result;
+    }
+
+    // Windows pass 2 covered in the last analyse() call.
+    const std::vector<Window>& lastWindows() const {
+        return windows;
+    }
+
+private:
+    void scan(cv::VideoCapture& cap, std::map<long, AnalysedFrame>& frames) {
+        int stride = std::max(1, static_cast<int>(std::lround(fps / options.coarseFps)));
+        cv::Mat frame;
+        // grab() alone skips the colour conversion of frames that are not analysed.
+        for (long index = 0; cap.grab(); ++index) {
+            if (index % stride == 0 && cap.retrieve(frame)) {
+                frames[index] = analyseFrame(frame, index, cap.get(cv::CAP_PROP_POS_MSEC) / 1000.0, 1);
+            }
+        }
+    }
+
+    void scanKeyframes(const std::string& videoFilePath, std::map<long, AnalysedFrame>& frames) {
+        FFmpegReaderOptions readerOptions;
+        readerOptions.keyframesOnly = true;
+        FFmpegReader reader(videoFilePath, readerOptions);
+        cv::Mat frame;
+        double timestamp = 0.0;
+        while (reader.read(frame, timestamp)) {
+            long index = std::lround(std::max(0.0, timestamp) * fps);
+            frames[index] = analyseFrame(frame, index, timestamp, 1);
+        }
+    }
+
+    std::vector<Window> triggerWindows(const std::map<long, AnalysedFrame>& frames) const {
+        std::vector<Window> merged;
+        for (const auto& entry : frames) {
+            const AnalysedFrame& frame = entry.second;
+            bool triggered = std::any_of(frame.detections.begin(), frame.detections.end(), [this](const Detection& detection) {
+                bool classMatches = options.triggerClasses.empty()
+                    || std::find(options.triggerClasses.begin(), options.triggerClasses.end(), detection.class_id) != options.triggerClasses.end();
+                return classMatches && detection.confidence >= options.triggerConfidence;
+            });
+            if (!triggered) {
+                continue;
+            }
+
+            Window window{ std::max(0.0, frame.timestamp - options.secondsBefore), frame.timestamp + options.secondsAfter };
+            if (!merged.empty() && window.begin <= merged.back().end + 1.0 / fps) {
+                merged.back().end = std::max(merged.back().end, window.end);
+            } else {
+                merged.push_back(window);
+            }
+        }
+        return merged;
+    }
+
+    void refine(cv::VideoCapture& cap, const Window& window, std::map<long, AnalysedFrame>& frames) {
+        long first = static_cast<long>(std::floor(window.begin * fps));
+        long last = static_cast<long>(std::ceil(window.end * fps));
+        int stride = options.fineFps > 0 ? std::max(1, static_cast<int>(std::lround(fps / options.fineFps))) : 1;
+
+        cap.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(first));
+        cv::Mat frame;
+        for (long index = first; index <= last && cap.grab(); ++index) {
+            if ((index - first) % stride != 0 || frames.count(index)) {
+                continue;
+            }
+            if (cap.retrieve(frame)) {
+                frames[index] = analyseFrame(frame, index, cap.get(cv::CAP_PROP_POS_MSEC) / 1000.0, 2);
+            }
+        }
+    }
+
+    AnalysedFrame analyseFrame(const cv::Mat& frame, long index, double timestamp, int pass) {
+        AnalysedFrame result;
+        result.index = index;
+        // Fall back to the nominal frame time if the backend reports none.
+        result.timestamp = timestamp > 0.0 || index == 0 ? timestamp : index / fps;
+        result.pass = pass;
+        result.detections = inf.runInference(frame);
+        return result;
+    }
+
+    Inference& inf;
+    Options options;
+    double fps{0.0};
+    std::vector<Window> windows;
+};
+
+#endif // TWOPASSANALYZER_H
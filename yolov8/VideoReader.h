@@ -2,18 +2,61 @@
 #ifndef VIDEOREADER_H
 #define VIDEOREADER_H
 
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 #include <opencv2/opencv.hpp>
 #include "FrameQueue.h"
+#include "FrameResult.h"
+#include "ffmpeg_reader.h"
 
 class VideoReader {
 public:
-    VideoReader(const std::string& videoFilePath, ThreadSafeQueue<cv::Mat>& frameQueue, int framesPerSecond)
+    VideoReader(const std::string& videoFilePath, ThreadSafeQueue<TimedFrame>& frameQueue, int framesPerSecond)
         : videoFilePath(videoFilePath), frameQueue(frameQueue), framesPerSecond(framesPerSecond) {}
 
+    // Reads a file no faster than its frame rate, like a live camera would
+    // deliver it. Only meaningful for the thread-per-stage mode.
+    void setRealTime(bool enabled) {
+        realTime = enabled;
+    }
+
+    // Decodes the file on `count` threads, each with its own VideoCapture.
+    // The file is cut into chunks of chunkSeconds that the threads claim in
+    // order; frames keep their global index and are queued in file order, with
+    // at most 2 * count chunks decoded ahead of the oldest unfinished one.
+    // Ignored in real-time mode and for files that cannot be seeked.
+    void setSegments(int count, double chunkSeconds = 10.0) {
+        segments = std::max(1, count);
+        segmentSeconds = chunkSeconds;
+    }
+
+    // Triage mode: decode only the keyframes (I-frames) of the file through
+    // FFmpegReader, skipping P/B-frame decoding. Every keyframe is queued,
+    // stamped with its presentation time; framesPerSecond does not apply.
+    // Needs a build with YOLOV8_WITH_FFMPEG.
+    void setKeyframesOnly(bool enabled) {
+        keyframesOnly = enabled;
+    }
+
     void operator()() {
+        if (keyframesOnly) {
+            readKeyframes();
+            return;
+        }
+        if (segments > 1 && !realTime && readSegments()) {
+            return;
+        }
+
         cv::VideoCapture cap(videoFilePath);
         if (!cap.isOpened()) {
             std::cerr << "Error: Could not open video file." << std::endl;
+            frameQueue.close();
             return;
         }
 
@@ -22,15 +65,19 @@ public:
 
         cv::Mat frame;
         int frameCount = 0;
+        auto start = std::chrono::steady_clock::now();
 
         while (true) {
+            if (realTime && fps > 0) {
+                std::this_thread::sleep_until(start + std::chrono::duration<double>(frameCount / fps));
+            }
             cap >> frame;
             if (frame.empty()) {
                 break;
             }
 
             if (frameCount % frameInterval == 0) {
-                frameQueue.push(frame.clone());
+                frameQueue.push(TimedFrame{ frame.clone(), frameCount, std::chrono::steady_clock::now(), cap.get(cv::CAP_PROP_POS_MSEC) / 1000.0 });
                 std::cout << "Frame " << frameCount << " added to queue." << std::endl;
             }
 
@@ -38,13 +85,197 @@ public:
         }
 
         cap.release();
+        frameQueue.close();
         std::cout << "Video reading completed. Total frames added to queue: " << frameCount / frameInterval << std::endl;
     }
 
+    // Parallel decode for setSegments(). Returns false, without queueing
+    // anything, when the file has to be read sequentially instead.
+    bool readSegments() {
+        cv::VideoCapture probe(videoFilePath);
+        if (!probe.isOpened()) {
+            return false;
+        }
+        double fps = probe.get(cv::CAP_PROP_FPS);
+        long totalFrames = static_cast<long>(probe.get(cv::CAP_PROP_FRAME_COUNT));
+        // Seeks have to land on the requested frame, or chunks would overlap
+        // or leave gaps. The backend decodes up from the preceding keyframe.
+        bool seekable = totalFrames > 1 && probe.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(totalFrames / 2))
+                        && static_cast<long>(probe.get(cv::CAP_PROP_POS_FRAMES)) == totalFrames / 2;
+        probe.release();
+        if (fps <= 0 || !seekable) {
+            std::cerr << "Warning: " << videoFilePath << " cannot be split, reading it sequentially." << std::endl;
+            return false;
+        }
+
+        const int frameInterval = std::max(1, static_cast<int>(fps / framesPerSecond));
+        const long chunkFrames = std::max<long>(1, static_cast<long>(segmentSeconds * fps));
+        const long chunkCount = (totalFrames + chunkFrames - 1) / chunkFrames;
+        const long maxAhead = 2L * segments;
+
+        // Frames of the oldest unfinished chunk go straight to the queue;
+        // later chunks are held back until every chunk before them is done.
+        std::mutex mutex;
+        std::condition_variable claimable;
+        long nextChunk = 0;
+        long head = 0;
+        long queued = 0;
+        std::map<long, std::vector<TimedFrame>> buffered;
+        std::set<long> done;
+
+        auto deliver = [&](long chunk, TimedFrame&& frame) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (chunk == head) {
+                frameQueue.push(frame);
+                queued++;
+            } else {
+                buffered[chunk].push_back(std::move(frame));
+            }
+        };
+
+        auto finish = [&](long chunk) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.insert(chunk);
+            while (true) {
+                auto it = buffered.find(head);
+                if (it != buffered.end()) {
+                    for (const TimedFrame& frame : it->second) {
+                        frameQueue.push(frame);
+                    }
+                    queued += static_cast<long>(it->second.size());
+                    buffered.erase(it);
+                }
+                if (!done.erase(head)) {
+                    break;
+                }
+                head++;
+            }
+            claimable.notify_all();
+        };
+
+        auto decode = [&] {
+            cv::VideoCapture cap(videoFilePath);
+            if (!cap.isOpened()) {
+                std::cerr << "Error: Could not open video file." << std::endl;
+                return;
+            }
+            cv::Mat frame;
+            long position = -1;
+            while (true) {
+                long chunk;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    claimable.wait(lock, [&] { return nextChunk >= chunkCount || nextChunk < head + maxAhead; });
+                    if (nextChunk >= chunkCount) {
+                        break;
+                    }
+                    chunk = nextChunk++;
+                }
+
+                long first = chunk * chunkFrames;
+                // The frame count is an estimate, so the last chunk runs to the end.
+                long last = chunk + 1 == chunkCount ? LONG_MAX : first + chunkFrames;
+                if (position != first) {
+                    cap.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(first));
+                    position = first;
+                }
+                while (position < last && cap.read(frame)) {
+                    if (position % frameInterval == 0) {
+                        deliver(chunk, TimedFrame{ frame.clone(), position, std::chrono::steady_clock::now(), cap.get(cv::CAP_PROP_POS_MSEC) / 1000.0 });
+                    }
+                    position++;
+                }
+                finish(chunk);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < segments; ++i) {
+            threads.emplace_back(decode);
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        frameQueue.close();
+        std::cout << "Video reading completed on " << segments << " threads. Total frames added to queue: " << queued << std::endl;
+        return true;
+    }
+
+    void readKeyframes() {
+        auto start = std::chrono::steady_clock::now();
+        long keyframes = 0;
+        try {
+            FFmpegReaderOptions options;
+            options.keyframesOnly = true;
+            FFmpegReader reader(videoFilePath, options);
+
+            while (true) {
+                // A fresh Mat per frame: the previous one is still in flight downstream.
+                cv::Mat frame;
+                double timestamp = -1.0;
+                if (!reader.read(frame, timestamp)) {
+                    break;
+                }
+                frameQueue.push(TimedFrame{ frame, keyframes++, std::chrono::steady_clock::now(), timestamp });
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        frameQueue.close();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Keyframe scan completed: " << keyframes << " keyframes in " << seconds << " s ("
+                  << (seconds > 0.0 ? keyframes / seconds : 0.0) << " keyframes/s)." << std::endl;
+    }
+
+#ifdef YOLOV8_COROUTINES
+    Task run(CoroExecutor& executor) {
+        co_await executor.schedule();
+
+        cv::VideoCapture cap(videoFilePath);
+        if (!cap.isOpened()) {
+            std::cerr << "Error: Could not open video file." << std::endl;
+            frameQueue.close();
+            co_return;
+        }
+
+        double fps = cap.get(cv::CAP_PROP_FPS);
+        int frameInterval = static_cast<int>(fps / framesPerSecond);
+
+        cv::Mat frame;
+        int frameCount = 0;
+
+        while (true) {
+            cap >> frame;
+            if (frame.empty()) {
+                break;
+            }
+
+            if (frameCount % frameInterval == 0) {
+                frameQueue.push(TimedFrame{ frame.clone(), frameCount, std::chrono::steady_clock::now() });
+            }
+
+            frameCount++;
+
+            // Let the other pipelines on this executor make progress.
+            co_await executor.yield();
+        }
+
+        cap.release();
+        frameQueue.close();
+        std::cout << videoFilePath << ": reading completed, " << frameCount / frameInterval << " frames queued." << std::endl;
+    }
+#endif
+
 private:
     std::string videoFilePath;
-    ThreadSafeQueue<cv::Mat>& frameQueue;
+    ThreadSafeQueue<TimedFrame>& frameQueue;
     int framesPerSecond;
+    bool realTime{false};
+    int segments{1};
+    double segmentSeconds{10.0};
+    bool keyframesOnly{false};
 };
 
 #endif // VIDEOREADER_H
@@ -0,0 +1,293 @@
+#include "backend.h"
+#include "eigen_engine.h"
+#include "model_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef YOLOV8_WITH_ONNXRUNTIME
+#include <onnxruntime_cxx_api.h>
+#endif
+
+OpenCVDnnBackend::OpenCVDnnBackend(bool runWithCuda)
+{
+    cudaEnabled = runWithCuda;
+}
+
+void OpenCVDnnBackend::loadModel(const std::string &modelPath)
+{
+    // Parsed straight from the mapping; the parser copies what it keeps.
+    std::shared_ptr<const MappedFile> file = mapModelFile(modelPath);
+    net = cv::dnn::readNetFromONNX(file->data(), file->size());
+    if (cudaEnabled)
+    {
+        std::cout << "\nRunning on CUDA" << std::endl;
+        net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+        net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+    }
+    else
+    {
+        std::cout << "\nRunning on CPU" << std::endl;
+        net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+        net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    }
+    outputNames = net.getUnconnectedOutLayersNames();
+}
+
+void OpenCVDnnBackend::forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs)
+{
+    net.setInput(blob);
+    net.forward(outputs, outputNames);
+}
+
+std::string OpenCVDnnBackend::name() const
+{
+    return cudaEnabled ? "opencv-dnn-cuda" : "opencv-dnn-cpu";
+}
+
+#ifdef YOLOV8_WITH_ONNXRUNTIME
+namespace
+{
+Ort::Env &ortEnv()
+{
+    // One environment per process, shared by every session.
+    static Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "YOLOv8Det");
+    return env;
+}
+
+// Sessions created with it share the weights their kernels pre-pack (the bulk
+// of a convolutional model on CPU), so replicas of one model keep one copy.
+Ort::PrepackedWeightsContainer &prepackedWeights()
+{
+    static Ort::PrepackedWeightsContainer container;
+    return container;
+}
+}
+
+struct OnnxRuntimeBackend::Session
+{
+    Ort::Session session{nullptr};
+    Ort::MemoryInfo memoryInfo{Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)};
+
+    std::vector<std::string> inputNames;
+    std::vector<std::string> outputNames;
+    std::vector<const char *> inputNamePtrs;
+    std::vector<const char *> outputNamePtrs;
+
+    // Keeps the tensors returned by the last Run() alive for the output Mats.
+    std::vector<Ort::Value> outputValues;
+};
+
+OnnxRuntimeBackend::OnnxRuntimeBackend(int intraOpThreads, int interOpThreads, const std::vector<int> &cpus, const std::string &cacheDirectory)
+    : intraOpThreads(intraOpThreads), interOpThreads(interOpThreads), cpus(cpus), cacheDirectory(cacheDirectory)
+{
+}
+
+OnnxRuntimeBackend::~OnnxRuntimeBackend() = default;
+
+void OnnxRuntimeBackend::loadModel(const std::string &modelPath)
+{
+    Ort::SessionOptions options;
+    if (!cpus.empty())
+    {
+        // The calling thread is intra-op thread 0 and is placed by its owner;
+        // the remaining threads get one CPU each (ids are 1-based here).
+        if (intraOpThreads <= 0)
+            intraOpThreads = static_cast<int>(cpus.size());
+        std::string affinities;
+        for (int i = 1; i < intraOpThreads; ++i)
+            affinities += (i > 1 ? ";" : "") + std::to_string(cpus[i % cpus.size()] + 1);
+        if (!affinities.empty())
+            options.AddConfigEntry("session.intra_op_thread_affinities", affinities.c_str());
+    }
+    options.SetIntraOpNumThreads(intraOpThreads);
+    options.SetInterOpNumThreads(interOpThreads);
+    options.SetExecutionMode(interOpThreads > 1 ? ExecutionMode::ORT_PARALLEL : ExecutionMode::ORT_SEQUENTIAL);
+    options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+
+    // With a cache directory the optimised graph is saved on the first start
+    // (under a temporary name, renamed once complete, so that concurrent
+    // starts never read half a file) and loaded as is afterwards.
+    std::string cachePath = cacheDirectory.empty() ? "" : modelCachePath(cacheDirectory, modelPath, ".opt.onnx");
+    std::string partialPath;
+    bool cached = !cachePath.empty() && std::filesystem::exists(cachePath);
+    if (cached)
+    {
+        options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+    }
+    else if (!cachePath.empty())
+    {
+        std::filesystem::create_directories(cacheDirectory);
+        partialPath = cachePath + ".partial-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+#ifdef _WIN32
+        std::wstring widePath(partialPath.begin(), partialPath.end());
+        options.SetOptimizedModelFilePath(widePath.c_str());
+#else
+        options.SetOptimizedModelFilePath(partialPath.c_str());
+#endif
+    }
+
+    session = std::make_unique<Session>();
+    std::shared_ptr<const MappedFile> file = mapModelFile(cached ? cachePath : modelPath);
+    session->session = Ort::Session(ortEnv(), file->data(), file->size(), options, prepackedWeights());
+
+    if (!partialPath.empty())
+    {
+        std::error_code error;
+        std::filesystem::rename(partialPath, cachePath, error);
+        if (error)
+            std::filesystem::remove(partialPath, error);
+    }
+
+    Ort::AllocatorWithDefaultOptions allocator;
+    for (size_t i = 0; i < session->session.GetInputCount(); ++i)
+        session->inputNames.push_back(session->session.GetInputNameAllocated(i, allocator).get());
+    for (size_t i = 0; i < session->session.GetOutputCount(); ++i)
+        session->outputNames.push_back(session->session.GetOutputNameAllocated(i, allocator).get());
+    for (const std::string &name : session->inputNames)
+        session->inputNamePtrs.push_back(name.c_str());
+    for (const std::string &name : session->outputNames)
+        session->outputNamePtrs.push_back(name.c_str());
+
+    std::cout << "\nRunning on ONNX Runtime CPU (intra-op " << intraOpThreads
+              << ", inter-op " << interOpThreads << (cached ? ", cached optimised model" : "") << ")" << std::endl;
+}
+
+void OnnxRuntimeBackend::forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs)
+{
+    CV_Assert(blob.isContinuous() && blob.type() == CV_32F);
+
+    std::vector<int64_t> inputShape;
+    for (int i = 0; i < blob.dims; ++i)
+        inputShape.push_back(blob.size[i]);
+
+    Ort::Value input = Ort::Value::CreateTensor<float>(session->memoryInfo, (float *)blob.data, blob.total(),
+                                                       inputShape.data(), inputShape.size());
+
+    session->outputValues = session->session.Run(Ort::RunOptions{nullptr},
+                                                 session->inputNamePtrs.data(), &input, 1,
+                                                 session->outputNamePtrs.data(), session->outputNamePtrs.size());
+
+    outputs.clear();
+    for (Ort::Value &value : session->outputValues)
+    {
+        std::vector<int64_t> shape = value.GetTensorTypeAndShapeInfo().GetShape();
+        std::vector<int> sizes(shape.begin(), shape.end());
+        outputs.emplace_back(sizes, CV_32F, value.GetTensorMutableData<float>());
+    }
+}
+
+std::string OnnxRuntimeBackend::name() const
+{
+    return "onnxruntime-cpu";
+}
+#endif
+
+EigenTensorBackend::EigenTensorBackend(const std::string &weightsPath, int numThreads, const std::vector<int> &cpus)
+    : weightsPath(weightsPath), numThreads(numThreads), cpus(cpus)
+{
+}
+
+EigenTensorBackend::~EigenTensorBackend() = default;
+
+void EigenTensorBackend::loadModel(const std::string &modelPath)
+{
+    if (weightsPath.empty())
+        weightsPath = modelPath.substr(0, modelPath.find_last_of('.')) + ".y8w";
+    engine = std::make_unique<EigenEngine>(weightsPath, numThreads, cpus);
+
+    std::cout << "\nRunning on Eigen Tensor CPU (" << engine->threadCount() << " threads)" << std::endl;
+}
+
+void EigenTensorBackend::forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs)
+{
+    CV_Assert(blob.dims == 4 && blob.size[1] == 3 && blob.isContinuous());
+
+    // The engine runs one image at a time; a batch is evaluated in sequence.
+    const int batch = blob.size[0];
+    const int height = blob.size[2];
+    const int width = blob.size[3];
+    if (batch == 1)
+    {
+        engine->forward(blob.ptr<float>(), width, height, output);
+    }
+    else
+    {
+        const size_t imageSize = size_t(3) * width * height;
+        const size_t outputSize = size_t(engine->outputChannels()) * engine->anchorCount(width, height);
+        output.resize(batch * outputSize);
+        for (int i = 0; i < batch; ++i)
+        {
+            engine->forward(blob.ptr<float>() + i * imageSize, width, height, imageOutput);
+            std::copy(imageOutput.begin(), imageOutput.end(), output.begin() + i * outputSize);
+        }
+    }
+
+    std::vector<int> sizes = {batch, engine->outputChannels(), engine->anchorCount(width, height)};
+    outputs.assign(1, cv::Mat(sizes, CV_32F, output.data()));
+}
+
+std::string EigenTensorBackend::name() const
+{
+    return "eigen-tensor-cpu";
+}
+
+const char *backendTypeName(BackendType type)
+{
+    switch (type)
+    {
+    case BackendType::OpenCVDnn:
+        return "opencv";
+    case BackendType::OnnxRuntime:
+        return "onnxruntime";
+    case BackendType::EigenTensor:
+        return "eigen";
+    }
+    return "unknown";
+}
+
+BackendType backendTypeFromName(const std::string &name)
+{
+    for (BackendType type : {BackendType::OpenCVDnn, BackendType::OnnxRuntime, BackendType::EigenTensor})
+        if (name == backendTypeName(type))
+            return type;
+    throw std::runtime_error("Unknown backend: " + name);
+}
+
+bool isBackendAvailable(BackendType type)
+{
+    switch (type)
+    {
+    case BackendType::OpenCVDnn:
+        return true;
+    case BackendType::OnnxRuntime:
+#ifdef YOLOV8_WITH_ONNXRUNTIME
+        return true;
+#else
+        return false;
+#endif
+    case BackendType::EigenTensor:
+        return true;
+    }
+    return false;
+}
+
+std::unique_ptr<InferenceBackend> createBackend(const BackendOptions &options, bool runWithCuda)
+{
+    switch (options.type)
+    {
+    case BackendType::OpenCVDnn:
+        return std::make_unique<OpenCVDnnBackend>(runWithCuda);
+    case BackendType::OnnxRuntime:
+#ifdef YOLOV8_WITH_ONNXRUNTIME
+        return std::make_unique<OnnxRuntimeBackend>(options.intraOpThreads, options.interOpThreads, options.cpus, options.modelCacheDirectory);
+#else
+        break;
+#endif
+    case BackendType::EigenTensor:
+        return std::make_unique<EigenTensorBackend>(options.weightsPath, options.intraOpThreads, options.cpus);
+    }
+    throw std::runtime_error(std::string("Backend not compiled in: ") + backendTypeName(options.type));
+}
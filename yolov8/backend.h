@@ -0,0 +1,121 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+// Cpp native
+#include <memory>
+#include <string>
+#include <vector>
+
+// OpenCV / DNN / Inference
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+
+enum class BackendType
+{
+    OpenCVDnn,
+    OnnxRuntime,
+    EigenTensor
+};
+
+struct BackendOptions
+{
+    BackendType type{BackendType::OpenCVDnn};
+
+    // ONNX Runtime and Eigen Tensor, 0 lets the runtime pick (Eigen then runs
+    // on the shared Executor).
+    int intraOpThreads{0};
+    // ONNX Runtime only.
+    int interOpThreads{0};
+    // CPUs for the intra-op threads of ONNX Runtime and Eigen Tensor, empty
+    // to leave placement to the OS.
+    std::vector<int> cpus{};
+
+    // Eigen Tensor only, defaults to the model path with a .y8w extension.
+    std::string weightsPath{};
+
+    // ONNX Runtime only: directory for the graph-optimised model. The first
+    // start saves it; later starts load it with the optimisation passes
+    // switched off. The optimised graph may use kernels specific to this
+    // CPU, so the cache belongs to one machine type.
+    std::string modelCacheDirectory{};
+};
+
+// The part of the model that turns an NCHW float blob into raw output tensors.
+// ONNX files are memory-mapped (see mapModelFile) and parsed from memory.
+// Preprocessing and decoding stay in Inference so every backend is fed and read
+// the same way. The Mats returned by forward() may alias backend memory and are
+// only valid until the next call.
+class InferenceBackend
+{
+public:
+    virtual ~InferenceBackend() = default;
+
+    virtual void loadModel(const std::string &modelPath) = 0;
+    virtual void forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs) = 0;
+    virtual std::string name() const = 0;
+};
+
+class OpenCVDnnBackend : public InferenceBackend
+{
+public:
+    explicit OpenCVDnnBackend(bool runWithCuda);
+
+    void loadModel(const std::string &modelPath) override;
+    void forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs) override;
+    std::string name() const override;
+
+private:
+    bool cudaEnabled{};
+    cv::dnn::Net net;
+    std::vector<std::string> outputNames;
+};
+
+#ifdef YOLOV8_WITH_ONNXRUNTIME
+class OnnxRuntimeBackend : public InferenceBackend
+{
+public:
+    OnnxRuntimeBackend(int intraOpThreads, int interOpThreads, const std::vector<int> &cpus = {}, const std::string &cacheDirectory = "");
+    ~OnnxRuntimeBackend() override;
+
+    void loadModel(const std::string &modelPath) override;
+    void forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs) override;
+    std::string name() const override;
+
+private:
+    struct Session;
+    std::unique_ptr<Session> session;
+    int intraOpThreads{};
+    int interOpThreads{};
+    std::vector<int> cpus;
+    std::string cacheDirectory;
+};
+#endif
+
+class EigenEngine;
+
+class EigenTensorBackend : public InferenceBackend
+{
+public:
+    EigenTensorBackend(const std::string &weightsPath, int numThreads, const std::vector<int> &cpus = {});
+    ~EigenTensorBackend() override;
+
+    void loadModel(const std::string &modelPath) override;
+    void forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs) override;
+    std::string name() const override;
+
+private:
+    std::string weightsPath;
+    int numThreads{};
+    std::vector<int> cpus;
+    std::unique_ptr<EigenEngine> engine;
+    std::vector<float> imageOutput;
+    std::vector<float> output;
+};
+
+const char *backendTypeName(BackendType type);
+// Inverse of backendTypeName; throws on an unknown name.
+BackendType backendTypeFromName(const std::string &name);
+bool isBackendAvailable(BackendType type);
+std::unique_ptr<InferenceBackend> createBackend(const BackendOptions &options, bool runWithCuda);
+
+#endif // BACKEND_H
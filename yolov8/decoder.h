@@ -0,0 +1,167 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+// Cpp native
+#include <vector>
+
+// OpenCV / DNN / Inference
+#include <opencv2/opencv.hpp>
+
+// yolov5 has an output of shape (batchSize, 25200, 85) (Num classes + box[x,y,w,h] + confidence[c])
+// yolov8 has an output of shape (batchSize, 84,  8400) (Num classes + box[x,y,w,h])
+enum class OutputLayout
+{
+    AnchorMajor,  // yolov5, one row of 5 + nc values per anchor
+    ChannelMajor  // yolov8, one row of anchors per channel
+};
+
+struct DecodeParams
+{
+    int rows{0};        // anchors
+    int numClasses{0};  // used by the generic decoder only
+    float xFactor{1.0f};
+    float yFactor{1.0f};
+    float confidenceThreshold{0.25f};
+    float scoreThreshold{0.45f};
+};
+
+// Candidates before NMS plus per-anchor scratch reused across frames.
+struct DecodedBoxes
+{
+    std::vector<int> classIds;
+    std::vector<float> confidences;
+    std::vector<cv::Rect> boxes;
+
+    std::vector<float> bestScore;
+    std::vector<int> bestClass;
+
+    void clear()
+    {
+        classIds.clear();
+        confidences.clear();
+        boxes.clear();
+    }
+};
+
+typedef void (*DecodeFunction)(const float *data, const DecodeParams &params, DecodedBoxes &out);
+
+namespace detail
+{
+inline void pushBox(DecodedBoxes &out, const DecodeParams &params, int classId, float confidence,
+                    float x, float y, float w, float h)
+{
+    int left = int((x - 0.5 * w) * params.xFactor);
+    int top = int((y - 0.5 * h) * params.yFactor);
+
+    int width = int(w * params.xFactor);
+    int height = int(h * params.yFactor);
+
+    out.classIds.push_back(classId);
+    out.confidences.push_back(confidence);
+    out.boxes.push_back(cv::Rect(left, top, width, height));
+}
+}
+
+// NumClasses > 0 fixes the class count at compile time so the class loops are
+// fully known to the compiler; NumClasses == 0 reads it from params.
+template <OutputLayout Layout, int NumClasses>
+void decodeOutput(const float *data, const DecodeParams &params, DecodedBoxes &out);
+
+template <int NumClasses>
+void decodeChannelMajor(const float *data, const DecodeParams &params, DecodedBoxes &out)
+{
+    const int rows = params.rows;
+    const int numClasses = NumClasses > 0 ? NumClasses : params.numClasses;
+
+    // Running argmax over classes, one contiguous row of anchors at a time,
+    // instead of transposing the output and scanning each anchor's scores.
+    out.bestScore.assign(data + 4 * rows, data + 5 * rows);
+    out.bestClass.assign(rows, 0);
+    float *bestScore = out.bestScore.data();
+    int *bestClass = out.bestClass.data();
+
+    for (int c = 1; c < numClasses; ++c)
+    {
+        const float *scores = data + (4 + c) * rows;
+        for (int i = 0; i < rows; ++i)
+        {
+            const bool better = scores[i] > bestScore[i];
+            bestScore[i] = better ? scores[i] : bestScore[i];
+            bestClass[i] = better ? c : bestClass[i];
+        }
+    }
+
+    for (int i = 0; i < rows; ++i)
+    {
+        if (bestScore[i] > params.scoreThreshold)
+            detail::pushBox(out, params, bestClass[i], bestScore[i],
+                            data[i], data[rows + i], data[2 * rows + i], data[3 * rows + i]);
+    }
+}
+
+template <int NumClasses>
+void decodeAnchorMajor(const float *data, const DecodeParams &params, DecodedBoxes &out)
+{
+    const int numClasses = NumClasses > 0 ? NumClasses : params.numClasses;
+    const int dimensions = 5 + numClasses;
+
+    for (int i = 0; i < params.rows; ++i, data += dimensions)
+    {
+        float confidence = data[4];
+        if (confidence < params.confidenceThreshold)
+            continue;
+
+        const float *classesScores = data + 5;
+        int classId = 0;
+        float maxClassScore = classesScores[0];
+        for (int c = 1; c < numClasses; ++c)
+        {
+            if (classesScores[c] > maxClassScore)
+            {
+                maxClassScore = classesScores[c];
+                classId = c;
+            }
+        }
+
+        if (maxClassScore > params.scoreThreshold)
+            detail::pushBox(out, params, classId, confidence, data[0], data[1], data[2], data[3]);
+    }
+}
+
+template <OutputLayout Layout, int NumClasses>
+void decodeOutput(const float *data, const DecodeParams &params, DecodedBoxes &out)
+{
+    if (Layout == OutputLayout::ChannelMajor)
+        decodeChannelMajor<NumClasses>(data, params, out);
+    else
+        decodeAnchorMajor<NumClasses>(data, params, out);
+}
+
+// Specialised for the single-class and COCO heads, generic otherwise.
+inline DecodeFunction selectDecoder(OutputLayout layout, int numClasses)
+{
+    if (layout == OutputLayout::ChannelMajor)
+    {
+        switch (numClasses)
+        {
+        case 1:
+            return &decodeOutput<OutputLayout::ChannelMajor, 1>;
+        case 80:
+            return &decodeOutput<OutputLayout::ChannelMajor, 80>;
+        default:
+            return &decodeOutput<OutputLayout::ChannelMajor, 0>;
+        }
+    }
+
+    switch (numClasses)
+    {
+    case 1:
+        return &decodeOutput<OutputLayout::AnchorMajor, 1>;
+    case 80:
+        return &decodeOutput<OutputLayout::AnchorMajor, 80>;
+    default:
+        return &decodeOutput<OutputLayout::AnchorMajor, 0>;
+    }
+}
+
+#endif // DECODER_H
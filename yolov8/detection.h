@@ -0,0 +1,120 @@
+#ifndef DETECTION_H
+#define DETECTION_H
+
+// Cpp native
+#include <random>
+#include <string>
+#include <vector>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// Legacy result type, kept for the drivers and ResultSaver.
+struct Detection
+{
+    int class_id{0};
+    std::string className{};
+    float confidence{0.0};
+    cv::Scalar color{};
+    cv::Rect box{};
+};
+
+// Plain-old-data result; names and colors are looked up in a ClassTable.
+struct CompactDetection
+{
+    float x{0.0f};
+    float y{0.0f};
+    float width{0.0f};
+    float height{0.0f};
+    int classId{0};
+    float score{0.0f};
+};
+
+// Structure-of-arrays view of one frame's detections for consumers that scan
+// a single field (all scores, all class ids) at a time.
+struct DetectionBatch
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> width;
+    std::vector<float> height;
+    std::vector<int> classId;
+    std::vector<float> score;
+
+    size_t size() const { return score.size(); }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        width.clear();
+        height.clear();
+        classId.clear();
+        score.clear();
+    }
+
+    void push(const CompactDetection &detection)
+    {
+        x.push_back(detection.x);
+        y.push_back(detection.y);
+        width.push_back(detection.width);
+        height.push_back(detection.height);
+        classId.push_back(detection.classId);
+        score.push_back(detection.score);
+    }
+
+    CompactDetection operator[](size_t i) const
+    {
+        return CompactDetection{x[i], y[i], width[i], height[i], classId[i], score[i]};
+    }
+};
+
+// Per-class name and drawing color, computed once and shared by every frame so
+// colors stay stable over time.
+class ClassTable
+{
+public:
+    explicit ClassTable(const std::vector<std::string> &classNames)
+        : names(classNames)
+    {
+        std::mt19937 gen(0x5eed);
+        std::uniform_int_distribution<int> dis(100, 255);
+        colors.reserve(names.size());
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            int b = dis(gen), g = dis(gen), r = dis(gen);
+            colors.emplace_back(b, g, r);
+        }
+    }
+
+    size_t size() const { return names.size(); }
+
+    const std::string &name(int classId) const
+    {
+        static const std::string unknown = "unknown";
+        return classId >= 0 && classId < (int)names.size() ? names[classId] : unknown;
+    }
+
+    const cv::Scalar &color(int classId) const
+    {
+        static const cv::Scalar gray(160, 160, 160);
+        return classId >= 0 && classId < (int)colors.size() ? colors[classId] : gray;
+    }
+
+private:
+    std::vector<std::string> names;
+    std::vector<cv::Scalar> colors;
+};
+
+inline Detection toDetection(const CompactDetection &detection, const ClassTable &table)
+{
+    Detection result;
+    result.class_id = detection.classId;
+    result.className = table.name(detection.classId);
+    result.confidence = detection.score;
+    result.color = table.color(detection.classId);
+    result.box = cv::Rect(cv::Rect2f(detection.x, detection.y, detection.width, detection.height));
+    return result;
+}
+
+#endif // DETECTION_H
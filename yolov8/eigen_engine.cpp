@@ -0,0 +1,472 @@
+#include "eigen_engine.h"
+#include "executor.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+typedef Eigen::array<Eigen::Index, 2> Dims2;
+typedef Eigen::array<Eigen::Index, 3> Dims3;
+
+struct WeightTensor
+{
+    std::vector<int> dims;
+    std::vector<float> data;
+};
+
+typedef std::map<std::string, WeightTensor> WeightMap;
+
+const uint32_t weightsMagic = 0x31573859; // "Y8W1"
+
+WeightMap readWeightFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Could not open weights file: " + path);
+
+    uint32_t magic = 0, count = 0;
+    file.read((char *)&magic, sizeof(magic));
+    file.read((char *)&count, sizeof(count));
+    if (!file || magic != weightsMagic)
+        throw std::runtime_error("Not a YOLOv8 weights file: " + path);
+
+    WeightMap weights;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t nameLength = 0, rank = 0;
+        file.read((char *)&nameLength, sizeof(nameLength));
+        std::string name(nameLength, '\0');
+        file.read(&name[0], nameLength);
+        file.read((char *)&rank, sizeof(rank));
+
+        WeightTensor tensor;
+        tensor.dims.resize(rank);
+        file.read((char *)tensor.dims.data(), rank * sizeof(int32_t));
+        size_t total = 1;
+        for (int d : tensor.dims)
+            total *= d;
+        tensor.data.resize(total);
+        file.read((char *)tensor.data.data(), total * sizeof(float));
+        if (!file)
+            throw std::runtime_error("Truncated weights file: " + path);
+
+        weights.emplace(std::move(name), std::move(tensor));
+    }
+    return weights;
+}
+
+const WeightTensor &findWeight(const WeightMap &weights, const std::string &name)
+{
+    auto it = weights.find(name);
+    if (it == weights.end())
+        throw std::runtime_error("Missing weight: " + name);
+    return it->second;
+}
+
+// prefix is the module path of the Conv2d, e.g. "model.2.m.0.cv1.conv".
+EigenConv loadConv(const WeightMap &weights, const std::string &prefix, int stride, bool silu)
+{
+    const WeightTensor &w = findWeight(weights, prefix + ".weight");
+    const WeightTensor &b = findWeight(weights, prefix + ".bias");
+    if (w.dims.size() != 4 || w.dims[2] != w.dims[3])
+        throw std::runtime_error("Unsupported convolution: " + prefix);
+
+    EigenConv layer;
+    layer.outChannels = w.dims[0];
+    layer.inChannels = w.dims[1];
+    layer.kernelSize = w.dims[2];
+    layer.stride = stride;
+    layer.pad = layer.kernelSize / 2;
+    layer.silu = silu;
+
+    // ONNX stores (out, in, kh, kw). Patches are flattened as in + C * (kw + k * kh)
+    // because dimension 1 of an activation is the width.
+    const int k = layer.kernelSize;
+    const int c = layer.inChannels;
+    layer.weight.resize(layer.outChannels, c * k * k);
+    for (int o = 0; o < layer.outChannels; ++o)
+        for (int i = 0; i < c; ++i)
+            for (int kh = 0; kh < k; ++kh)
+                for (int kw = 0; kw < k; ++kw)
+                    layer.weight(o, i + c * (kw + k * kh)) = w.data[((o * c + i) * k + kh) * k + kw];
+
+    layer.bias.resize(layer.outChannels);
+    for (int o = 0; o < layer.outChannels; ++o)
+        layer.bias(o) = b.data[o];
+    return layer;
+}
+
+EigenC2f loadC2f(const WeightMap &weights, const std::string &prefix, bool shortcut)
+{
+    EigenC2f block;
+    block.cv1 = loadConv(weights, prefix + ".cv1.conv", 1, true);
+    block.cv2 = loadConv(weights, prefix + ".cv2.conv", 1, true);
+    for (int i = 0; weights.count(prefix + ".m." + std::to_string(i) + ".cv1.conv.weight"); ++i)
+    {
+        std::string m = prefix + ".m." + std::to_string(i);
+        EigenBottleneck bottleneck;
+        bottleneck.cv1 = loadConv(weights, m + ".cv1.conv", 1, true);
+        bottleneck.cv2 = loadConv(weights, m + ".cv2.conv", 1, true);
+        bottleneck.add = shortcut && bottleneck.cv1.inChannels == bottleneck.cv2.outChannels;
+        block.m.push_back(std::move(bottleneck));
+    }
+    return block;
+}
+}
+
+EigenEngine::EigenEngine(const std::string &weightsPath, int numThreads, const std::vector<int> &cpus)
+    : EigenEngine(EigenWeights::load(weightsPath), numThreads, cpus)
+{
+}
+
+EigenEngine::EigenEngine(std::shared_ptr<const EigenWeights> weights, int numThreads, const std::vector<int> &cpus)
+    : weights(std::move(weights))
+{
+    if (numThreads <= 0 && !cpus.empty())
+        numThreads = static_cast<int>(cpus.size());
+    if (numThreads > 0)
+    {
+        pool = std::make_unique<PinnedThreadPool>(numThreads, PinnedThreadEnvironment(cpus));
+        threads = pool.get();
+    }
+    else
+    {
+        threads = Executor::instance().pool();
+        numThreads = threads->NumThreads();
+    }
+    poolDevice = std::make_unique<Eigen::ThreadPoolDevice>(threads, numThreads);
+    inlineDevice = std::make_unique<Eigen::ThreadPoolDevice>(threads, 1);
+    device = poolDevice.get();
+}
+
+std::shared_ptr<const EigenWeights> EigenWeights::load(const std::string &weightsPath)
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const EigenWeights>> loaded;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::shared_ptr<const EigenWeights> shared = loaded[weightsPath].lock())
+        return shared;
+
+    WeightMap file = readWeightFile(weightsPath);
+    auto model = std::make_shared<EigenWeights>();
+
+    for (int index : {0, 1, 3, 5, 7, 16, 19})
+        model->downsample.push_back(loadConv(file, "model." + std::to_string(index) + ".conv", 2, true));
+
+    // Backbone C2f blocks use residual bottlenecks, the neck ones do not.
+    for (int index : {2, 4, 6, 8})
+        model->stages.push_back(loadC2f(file, "model." + std::to_string(index), true));
+    for (int index : {12, 15, 18, 21})
+        model->stages.push_back(loadC2f(file, "model." + std::to_string(index), false));
+
+    model->spp.cv1 = loadConv(file, "model.9.cv1.conv", 1, true);
+    model->spp.cv2 = loadConv(file, "model.9.cv2.conv", 1, true);
+
+    EigenDetect &head = model->head;
+    for (int level = 0; file.count("model.22.cv2." + std::to_string(level) + ".0.conv.weight"); ++level)
+    {
+        std::string box = "model.22.cv2." + std::to_string(level);
+        std::string cls = "model.22.cv3." + std::to_string(level);
+        head.box.push_back({loadConv(file, box + ".0.conv", 1, true),
+                            loadConv(file, box + ".1.conv", 1, true),
+                            loadConv(file, box + ".2", 1, false)});
+        head.cls.push_back({loadConv(file, cls + ".0.conv", 1, true),
+                            loadConv(file, cls + ".1.conv", 1, true),
+                            loadConv(file, cls + ".2", 1, false)});
+    }
+    if (head.box.size() != 3)
+        throw std::runtime_error("Expected a three level detect head in " + weightsPath);
+    head.regMax = head.box[0][2].outChannels / 4;
+    head.numClasses = head.cls[0][2].outChannels;
+
+    loaded[weightsPath] = model;
+    return model;
+}
+
+size_t EigenWeights::byteSize() const
+{
+    size_t floats = 0;
+    auto add = [&floats](const EigenConv &layer) { floats += layer.weight.size() + layer.bias.size(); };
+    for (const EigenConv &layer : downsample)
+        add(layer);
+    for (const EigenC2f &block : stages)
+    {
+        add(block.cv1);
+        add(block.cv2);
+        for (const EigenBottleneck &bottleneck : block.m)
+        {
+            add(bottleneck.cv1);
+            add(bottleneck.cv2);
+        }
+    }
+    add(spp.cv1);
+    add(spp.cv2);
+    for (size_t level = 0; level < head.box.size(); ++level)
+        for (size_t i = 0; i < head.box[level].size(); ++i)
+        {
+            add(head.box[level][i]);
+            add(head.cls[level][i]);
+        }
+    return floats * sizeof(float);
+}
+
+int EigenEngine::numClasses() const
+{
+    return weights->head.numClasses;
+}
+
+int EigenEngine::outputChannels() const
+{
+    return 4 + weights->head.numClasses;
+}
+
+int EigenEngine::anchorCount(int width, int height) const
+{
+    int anchors = 0;
+    for (int stride : {8, 16, 32})
+        anchors += ((width + stride - 1) / stride) * ((height + stride - 1) / stride);
+    return anchors;
+}
+
+int EigenEngine::threadCount() const
+{
+    return poolDevice->numThreads();
+}
+
+EigenTensor3 EigenEngine::conv(const EigenConv &layer, const EigenTensor3 &x)
+{
+    const Eigen::Index inC = x.dimension(0), inW = x.dimension(1), inH = x.dimension(2);
+    const Eigen::Index k = layer.kernelSize, s = layer.stride, p = layer.pad;
+    const Eigen::Index outW = (inW + 2 * p - k) / s + 1;
+    const Eigen::Index outH = (inH + 2 * p - k) / s + 1;
+    const Eigen::Index outC = layer.outChannels;
+
+    EigenTensor3 result(outC, outW, outH);
+    Eigen::TensorMap<EigenTensor2> y(result.data(), outC, outW * outH);
+    const Eigen::array<Eigen::IndexPair<Eigen::Index>, 1> contractDims = {Eigen::IndexPair<Eigen::Index>(1, 0)};
+
+    if (k == 1 && s == 1)
+    {
+        y.device(*device) = layer.weight.contract(x.reshape(Dims2{inC, inW * inH}), contractDims);
+    }
+    else
+    {
+        // im2col into a reused buffer, then one GEMM on the thread pool. Channels
+        // are innermost, so every tap of the kernel is one contiguous copy.
+        patches.resize(inC * k * k, outW * outH);
+        const float *src = x.data();
+        float *dst = patches.data();
+        auto im2col = [=](Eigen::Index first, Eigen::Index last) {
+            for (Eigen::Index column = first; column < last; ++column)
+            {
+                const Eigen::Index ox = column % outW, oy = column / outW;
+                float *out = dst + column * inC * k * k;
+                for (Eigen::Index kh = 0; kh < k; ++kh)
+                    for (Eigen::Index kw = 0; kw < k; ++kw, out += inC)
+                    {
+                        const Eigen::Index ix = ox * s + kw - p, iy = oy * s + kh - p;
+                        if (ix < 0 || iy < 0 || ix >= inW || iy >= inH)
+                            std::fill(out, out + inC, 0.0f);
+                        else
+                            std::copy(src + (ix + inW * iy) * inC, src + (ix + inW * iy + 1) * inC, out);
+                    }
+            }
+        };
+        device->parallelFor(outW * outH, Eigen::TensorOpCost(inC * k * k * sizeof(float), inC * k * k * sizeof(float), 0), im2col);
+        y.device(*device) = layer.weight.contract(patches, contractDims);
+    }
+
+    auto biased = y + layer.bias.reshape(Dims2{outC, 1}).broadcast(Dims2{1, outW * outH});
+    if (layer.silu)
+        y.device(*device) = biased * biased.sigmoid();
+    else
+        y.device(*device) = biased;
+    return result;
+}
+
+EigenTensor3 EigenEngine::c2f(const EigenC2f &block, const EigenTensor3 &x)
+{
+    EigenTensor3 y = conv(block.cv1, x);
+    const Eigen::Index c = y.dimension(0) / 2, w = y.dimension(1), h = y.dimension(2);
+    const Eigen::Index n = block.m.size();
+
+    // cat(chunk(cv1(x), 2) + [m_i(...)]) assembled in place along the channel axis.
+    EigenTensor3 concat((2 + n) * c, w, h);
+    concat.slice(Dims3{0, 0, 0}, Dims3{2 * c, w, h}).device(*device) = y;
+
+    EigenTensor3 last = y.slice(Dims3{c, 0, 0}, Dims3{c, w, h});
+    for (Eigen::Index i = 0; i < n; ++i)
+    {
+        const EigenBottleneck &bottleneck = block.m[i];
+        EigenTensor3 out = conv(bottleneck.cv2, conv(bottleneck.cv1, last));
+        if (bottleneck.add)
+            out.device(*device) = out + last;
+        concat.slice(Dims3{(2 + i) * c, 0, 0}, Dims3{c, w, h}).device(*device) = out;
+        last = std::move(out);
+    }
+    return conv(block.cv2, concat);
+}
+
+EigenTensor3 EigenEngine::maxPool(const EigenTensor3 &x, int size)
+{
+    // Separable stride-1 max pool: running max of shifted slices along width,
+    // then along height, over a -inf padded copy.
+    const Eigen::Index c = x.dimension(0), w = x.dimension(1), h = x.dimension(2);
+    const Eigen::Index p = size / 2;
+    const float lowest = -std::numeric_limits<float>::infinity();
+    Eigen::array<std::pair<Eigen::Index, Eigen::Index>, 3> padding;
+    padding[0] = std::make_pair(0, 0);
+    padding[1] = std::make_pair(p, p);
+    padding[2] = std::make_pair(p, p);
+
+    EigenTensor3 padded(c, w + 2 * p, h + 2 * p);
+    padded.device(*device) = x.pad(padding, lowest);
+
+    EigenTensor3 rows(c, w, h + 2 * p);
+    rows.device(*device) = padded.slice(Dims3{0, 0, 0}, Dims3{c, w, h + 2 * p});
+    for (Eigen::Index i = 1; i < size; ++i)
+        rows.device(*device) = rows.cwiseMax(padded.slice(Dims3{0, i, 0}, Dims3{c, w, h + 2 * p}));
+
+    EigenTensor3 result(c, w, h);
+    result.device(*device) = rows.slice(Dims3{0, 0, 0}, Dims3{c, w, h});
+    for (Eigen::Index i = 1; i < size; ++i)
+        result.device(*device) = result.cwiseMax(rows.slice(Dims3{0, 0, i}, Dims3{c, w, h}));
+    return result;
+}
+
+EigenTensor3 EigenEngine::sppf(const EigenSPPF &block, const EigenTensor3 &x)
+{
+    EigenTensor3 y = conv(block.cv1, x);
+    const Eigen::Index c = y.dimension(0), w = y.dimension(1), h = y.dimension(2);
+
+    EigenTensor3 concat(4 * c, w, h);
+    concat.slice(Dims3{0, 0, 0}, Dims3{c, w, h}).device(*device) = y;
+    for (Eigen::Index i = 1; i < 4; ++i)
+    {
+        y = maxPool(y, block.poolSize);
+        concat.slice(Dims3{i * c, 0, 0}, Dims3{c, w, h}).device(*device) = y;
+    }
+    return conv(block.cv2, concat);
+}
+
+EigenTensor3 EigenEngine::upsample(const EigenTensor3 &x)
+{
+    // Nearest neighbour x2: (c, w, h) -> (c, 2, w, 2, h) -> (c, 2w, 2h).
+    const Eigen::Index c = x.dimension(0), w = x.dimension(1), h = x.dimension(2);
+    EigenTensor3 result(c, 2 * w, 2 * h);
+    result.device(*device) = x.reshape(Eigen::array<Eigen::Index, 5>{c, 1, w, 1, h})
+                                 .broadcast(Eigen::array<Eigen::Index, 5>{1, 2, 1, 2, 1})
+                                 .reshape(Dims3{c, 2 * w, 2 * h});
+    return result;
+}
+
+EigenTensor3 EigenEngine::concat(const EigenTensor3 &a, const EigenTensor3 &b)
+{
+    // Channel concatenation as two strided slice writes; concatenate() on the
+    // innermost dimension evaluates coefficient by coefficient.
+    const Eigen::Index ca = a.dimension(0), cb = b.dimension(0), w = a.dimension(1), h = a.dimension(2);
+    EigenTensor3 result(ca + cb, w, h);
+    result.slice(Dims3{0, 0, 0}, Dims3{ca, w, h}).device(*device) = a;
+    result.slice(Dims3{ca, 0, 0}, Dims3{cb, w, h}).device(*device) = b;
+    return result;
+}
+
+void EigenEngine::detect(const std::vector<EigenTensor3> &features, int inputWidth, EigenTensor2 &output)
+{
+    const EigenDetect &head = weights->head;
+    const Eigen::Index regMax = head.regMax, nc = head.numClasses;
+
+    Eigen::Index totalAnchors = 0;
+    for (const EigenTensor3 &feature : features)
+        totalAnchors += feature.dimension(1) * feature.dimension(2);
+
+    // (anchors, 4 + nc) col-major is the (4 + nc, anchors) row-major ONNX layout.
+    output.resize(totalAnchors, 4 + nc);
+
+    EigenTensor1 bins(regMax);
+    for (Eigen::Index i = 0; i < regMax; ++i)
+        bins(i) = float(i);
+
+    Eigen::Index offset = 0;
+    for (size_t level = 0; level < features.size(); ++level)
+    {
+        const EigenTensor3 &feature = features[level];
+        const Eigen::Index w = feature.dimension(1), h = feature.dimension(2), a = w * h;
+        const float stride = float(inputWidth) / float(w);
+
+        EigenTensor3 box = conv(head.box[level][2], conv(head.box[level][1], conv(head.box[level][0], feature)));
+        EigenTensor3 cls = conv(head.cls[level][2], conv(head.cls[level][1], conv(head.cls[level][0], feature)));
+
+        // DFL: softmax over the regMax bins of each side, then the expected bin.
+        const Eigen::array<Eigen::Index, 3> binShape{regMax, 4, a};
+        const Eigen::array<Eigen::Index, 3> binBroadcast{regMax, 1, 1};
+        const Eigen::array<Eigen::Index, 3> sideShape{1, 4, a};
+        auto logits = box.reshape(binShape);
+        EigenTensor3 e(regMax, 4, a);
+        e.device(*device) = (logits - logits.maximum(Eigen::array<Eigen::Index, 1>{0}).reshape(sideShape).broadcast(binBroadcast)).exp();
+        EigenTensor2 distance(4, a);
+        distance.device(*device) = (e * bins.reshape(Eigen::array<Eigen::Index, 3>{regMax, 1, 1}).broadcast(Eigen::array<Eigen::Index, 3>{1, 4, a})).sum(Eigen::array<Eigen::Index, 1>{0})
+                                   / e.sum(Eigen::array<Eigen::Index, 1>{0});
+
+        // Anchor centres in grid units, x fastest like make_anchors().
+        EigenTensor2 anchors(2, a);
+        for (Eigen::Index y = 0; y < h; ++y)
+            for (Eigen::Index x = 0; x < w; ++x)
+            {
+                anchors(0, x + w * y) = float(x) + 0.5f;
+                anchors(1, x + w * y) = float(y) + 0.5f;
+            }
+
+        auto lt = distance.slice(Dims2{0, 0}, Dims2{2, a});
+        auto rb = distance.slice(Dims2{2, 0}, Dims2{2, a});
+        const Eigen::array<Eigen::Index, 2> transpose{1, 0};
+        output.slice(Dims2{offset, 0}, Dims2{a, 2}).device(*device) = ((anchors + (rb - lt) * 0.5f) * stride).shuffle(transpose);
+        output.slice(Dims2{offset, 2}, Dims2{a, 2}).device(*device) = ((lt + rb) * stride).shuffle(transpose);
+        output.slice(Dims2{offset, 4}, Dims2{a, nc}).device(*device) = cls.reshape(Dims2{nc, a}).sigmoid().shuffle(transpose);
+
+        offset += a;
+    }
+}
+
+void EigenEngine::forward(const float *input, int width, int height, std::vector<float> &output)
+{
+    device = threads->CurrentThreadId() >= 0 ? inlineDevice.get() : poolDevice.get();
+
+    // NCHW row-major is (w, h, c) col-major; move channels to the front.
+    Eigen::TensorMap<const EigenTensor3> blob(input, width, height, 3);
+    EigenTensor3 x(3, width, height);
+    x.device(*device) = blob.shuffle(Dims3{2, 0, 1});
+
+    const std::vector<EigenConv> &downsample = weights->downsample;
+    const std::vector<EigenC2f> &stages = weights->stages;
+
+    // Backbone
+    x = conv(downsample[0], x);
+    x = conv(downsample[1], x);
+    x = c2f(stages[0], x);
+    x = conv(downsample[2], x);
+    EigenTensor3 p3 = c2f(stages[1], x);
+    x = conv(downsample[3], p3);
+    EigenTensor3 p4 = c2f(stages[2], x);
+    x = conv(downsample[4], p4);
+    x = c2f(stages[3], x);
+    EigenTensor3 p5 = sppf(weights->spp, x);
+
+    // Neck
+    EigenTensor3 n4 = c2f(stages[4], concat(upsample(p5), p4));
+    EigenTensor3 out3 = c2f(stages[5], concat(upsample(n4), p3));
+    EigenTensor3 out4 = c2f(stages[6], concat(conv(downsample[5], out3), n4));
+    EigenTensor3 out5 = c2f(stages[7], concat(conv(downsample[6], out4), p5));
+
+    // Head
+    EigenTensor2 result;
+    detect({out3, out4, out5}, width, result);
+    output.assign(result.data(), result.data() + result.size());
+}
@@ -0,0 +1,130 @@
+#ifndef EIGEN_ENGINE_H
+#define EIGEN_ENGINE_H
+
+// Cpp native
+#include <memory>
+#include <string>
+#include <vector>
+
+// Eigen / Tensor
+#ifndef EIGEN_USE_THREADS
+#define EIGEN_USE_THREADS
+#endif
+#include <unsupported/Eigen/CXX11/Tensor>
+
+#include "topology.h"
+
+// Activations are (channels, width, height) col-major, i.e. HWC in memory, so a
+// 1x1 convolution is a plain contraction over the channel dimension and the
+// spatial flattening matches the row-major anchor order of the ONNX export.
+typedef Eigen::Tensor<float, 3> EigenTensor3;
+typedef Eigen::Tensor<float, 2> EigenTensor2;
+typedef Eigen::Tensor<float, 1> EigenTensor1;
+
+// Convolution with BatchNorm already folded into weight and bias, optionally
+// followed by SiLU. The weight is stored as (out, k * k * in), column
+// i + in * (kw + k * kh), the row order of the im2col patches EigenEngine::conv
+// builds: channels innermost, then the kernel taps in row-major order.
+struct EigenConv
+{
+    EigenTensor2 weight;
+    EigenTensor1 bias;
+    int inChannels{0};
+    int outChannels{0};
+    int kernelSize{1};
+    int stride{1};
+    int pad{0};
+    bool silu{true};
+};
+
+struct EigenBottleneck
+{
+    EigenConv cv1;
+    EigenConv cv2;
+    bool add{false};
+};
+
+struct EigenC2f
+{
+    EigenConv cv1;
+    EigenConv cv2;
+    std::vector<EigenBottleneck> m;
+};
+
+struct EigenSPPF
+{
+    EigenConv cv1;
+    EigenConv cv2;
+    int poolSize{5};
+};
+
+struct EigenDetect
+{
+    int regMax{16};
+    int numClasses{0};
+    std::vector<std::vector<EigenConv>> box; // cv2[level][0..2]
+    std::vector<std::vector<EigenConv>> cls; // cv3[level][0..2]
+};
+
+// The immutable part of a model, every layer with its folded weights. Engines
+// only read it, so any number of them can share one copy and keep just their
+// own activation buffers.
+struct EigenWeights
+{
+    // Layer indices follow the model.N numbering of yolov8.yaml.
+    std::vector<EigenConv> downsample;   // 0, 1, 3, 5, 7, 16, 19
+    std::vector<EigenC2f> stages;        // 2, 4, 6, 8, 12, 15, 18, 21
+    EigenSPPF spp;                       // 9
+    EigenDetect head;                    // 22
+
+    // Loads weightsPath, or returns the copy loaded earlier while any engine
+    // still holds it.
+    static std::shared_ptr<const EigenWeights> load(const std::string &weightsPath);
+
+    // Folded weights and biases, held once however many engines share them.
+    size_t byteSize() const;
+};
+
+// Self-contained YOLOv8 detection model evaluated with Eigen Tensor expressions
+// on a ThreadPoolDevice. Weights come from tools/export_weights.py, which dumps
+// the (BN-fused) Conv initializers of the Ultralytics ONNX export.
+class EigenEngine
+{
+public:
+    // numThreads <= 0 without cpus runs on the process-wide Executor instead of
+    // a private pool. With cpus, the private pool's workers are pinned to them.
+    // Engines of one weights file share its EigenWeights.
+    explicit EigenEngine(const std::string &weightsPath, int numThreads = 0, const std::vector<int> &cpus = {});
+    EigenEngine(std::shared_ptr<const EigenWeights> weights, int numThreads = 0, const std::vector<int> &cpus = {});
+
+    // input is an NCHW float blob of shape (1, 3, height, width). output receives
+    // a row-major (4 + numClasses, anchors) matrix laid out like the ONNX output.
+    void forward(const float *input, int width, int height, std::vector<float> &output);
+
+    int numClasses() const;
+    int outputChannels() const;
+    int anchorCount(int width, int height) const;
+    int threadCount() const;
+
+private:
+    EigenTensor3 conv(const EigenConv &layer, const EigenTensor3 &x);
+    EigenTensor3 c2f(const EigenC2f &block, const EigenTensor3 &x);
+    EigenTensor3 sppf(const EigenSPPF &block, const EigenTensor3 &x);
+    EigenTensor3 maxPool(const EigenTensor3 &x, int size);
+    EigenTensor3 upsample(const EigenTensor3 &x);
+    EigenTensor3 concat(const EigenTensor3 &a, const EigenTensor3 &b);
+    void detect(const std::vector<EigenTensor3> &features, int inputWidth, EigenTensor2 &output);
+
+    std::shared_ptr<const EigenWeights> weights;
+
+    std::unique_ptr<PinnedThreadPool> pool; // null when running on the Executor
+    Eigen::ThreadPoolInterface *threads{nullptr};
+    std::unique_ptr<Eigen::ThreadPoolDevice> poolDevice;
+    // Used when forward() is itself called from a worker of the pool: blocking
+    // that worker on a barrier for work queued behind it could deadlock.
+    std::unique_ptr<Eigen::ThreadPoolDevice> inlineDevice;
+    Eigen::ThreadPoolDevice *device{nullptr};
+    EigenTensor2 patches;
+};
+
+#endif // EIGEN_ENGINE_H
@@ -0,0 +1,183 @@
+#include "executor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <opencv2/opencv.hpp>
+#if __has_include(<opencv2/core/parallel/parallel_backend.hpp>)
+#include <opencv2/core/parallel/parallel_backend.hpp>
+#define YOLOV8_OPENCV_PARALLEL_BACKEND 1
+#endif
+
+namespace
+{
+int requestedThreads = 0;
+std::vector<int> requestedCpus;
+std::atomic<bool> created{false};
+
+#ifdef YOLOV8_OPENCV_PARALLEL_BACKEND
+class ExecutorParallelBackend : public cv::parallel::ParallelForAPI
+{
+public:
+    explicit ExecutorParallelBackend(Executor &executor) : executor(executor) {}
+
+    void parallel_for(int tasks, FN_parallel_for_body_cb_t body_callback, void *callback_data) override
+    {
+        executor.parallelFor(tasks, [body_callback, callback_data](int start, int end) {
+            body_callback(start, end, callback_data);
+        });
+    }
+
+    // Non-pool callers report 0, pool workers 1..size().
+    int getThreadNum() const override { return executor.currentWorker() + 1; }
+    int getNumThreads() const override { return executor.size() + 1; }
+    int setNumThreads(int) override { return getNumThreads(); }
+    const char *getName() const override { return "yolov8-executor"; }
+
+private:
+    Executor &executor;
+};
+#endif
+}
+
+void Executor::configure(int numThreads, const std::vector<int> &cpus)
+{
+    if (created)
+        std::cerr << "Warning: Executor::configure called after the executor was created; ignored." << std::endl;
+    requestedThreads = numThreads;
+    requestedCpus = cpus;
+}
+
+Executor &Executor::instance()
+{
+    static Executor executor(requestedThreads, requestedCpus);
+    return executor;
+}
+
+Executor::Executor(int numThreads, const std::vector<int> &cpus)
+{
+    if (numThreads <= 0)
+        numThreads = cpus.empty() ? std::max(1u, std::thread::hardware_concurrency()) : static_cast<int>(cpus.size());
+    counters = std::make_unique<Counters[]>(numThreads + 1);
+    threadPool = std::make_unique<PinnedThreadPool>(numThreads, PinnedThreadEnvironment(cpus));
+    created = true;
+}
+
+void Executor::schedule(std::function<void()> task)
+{
+    threadPool->Schedule([this, task = std::move(task)] {
+        auto start = std::chrono::steady_clock::now();
+        task();
+        record(currentWorker(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    });
+}
+
+void Executor::parallelFor(int count, const std::function<void(int, int)> &body)
+{
+    if (count <= 0)
+        return;
+
+    // Chunks are claimed from a shared counter by the caller and by helper
+    // tasks. The caller never waits on a chunk that has not started, so a
+    // worker calling this cannot deadlock the pool.
+    struct Shared
+    {
+        std::function<void(int, int)> body;
+        int count{0};
+        int chunk{1};
+        std::atomic<int> next{0};
+        std::atomic<int> finished{0};
+        std::mutex mutex;
+        std::condition_variable condition;
+
+        void drain(Executor &executor)
+        {
+            while (true)
+            {
+                int start = next.fetch_add(chunk);
+                if (start >= count)
+                    return;
+                int end = std::min(count, start + chunk);
+                auto begin = std::chrono::steady_clock::now();
+                body(start, end);
+                executor.record(executor.currentWorker(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+                if (finished.fetch_add(end - start) + (end - start) == count)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    condition.notify_all();
+                }
+            }
+        }
+    };
+
+    auto shared = std::make_shared<Shared>();
+    shared->body = body;
+    shared->count = count;
+    int helpers = std::min(count, size()) - 1;
+    shared->chunk = std::max(1, count / (4 * (helpers + 1)));
+
+    for (int i = 0; i < helpers; ++i)
+        threadPool->Schedule([this, shared] { shared->drain(*this); });
+
+    shared->drain(*this);
+
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->condition.wait(lock, [&shared] { return shared->finished.load() == shared->count; });
+}
+
+int Executor::size() const
+{
+    return threadPool->NumThreads();
+}
+
+int Executor::currentWorker() const
+{
+    return threadPool->CurrentThreadId();
+}
+
+Eigen::ThreadPoolInterface *Executor::pool()
+{
+    return &view;
+}
+
+void Executor::record(int worker, double busyMs)
+{
+    Counters &slot = counters[worker >= 0 ? worker : size()];
+    slot.tasks++;
+    slot.busyMicros += long(busyMs * 1000.0);
+}
+
+std::vector<WorkerStats> Executor::stats() const
+{
+    std::vector<WorkerStats> result(size() + 1);
+    for (int i = 0; i <= size(); ++i)
+    {
+        result[i].tasks = counters[i].tasks;
+        result[i].busyMs = counters[i].busyMicros / 1000.0;
+    }
+    return result;
+}
+
+void Executor::printStats(std::ostream &out) const
+{
+    std::vector<WorkerStats> workers = stats();
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        out << (i + 1 < workers.size() ? "worker " + std::to_string(i) : std::string("external"))
+            << ": " << workers[i].tasks << " tasks, " << workers[i].busyMs << " ms busy" << std::endl;
+    }
+}
+
+bool Executor::installOpenCVBackend()
+{
+#ifdef YOLOV8_OPENCV_PARALLEL_BACKEND
+    cv::parallel::setParallelForBackend(std::make_shared<ExecutorParallelBackend>(*this));
+    return true;
+#else
+    std::cerr << "Warning: this OpenCV build has no pluggable parallel backend." << std::endl;
+    return false;
+#endif
+}
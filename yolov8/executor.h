@@ -0,0 +1,85 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+// Cpp native
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Eigen / ThreadPool
+#include <unsupported/Eigen/CXX11/ThreadPool>
+
+#include "topology.h"
+
+struct WorkerStats
+{
+    long tasks{0};
+    double busyMs{0.0};
+};
+
+// Process-wide work-stealing pool (Eigen's NonBlockingThreadPool). Pipeline
+// coroutines, AsyncInference requests, the Eigen Tensor engine and, once
+// installed, OpenCV's parallel_for_ all run on it, so the process keeps one
+// set of worker threads sized by configure().
+class Executor
+{
+public:
+    // Must be called before the first instance(); 0 means one per core.
+    // Worker i is pinned to cpus[i % cpus.size()] when cpus is not empty.
+    static void configure(int numThreads, const std::vector<int> &cpus = {});
+    static Executor &instance();
+
+    void schedule(std::function<void()> task);
+
+    // Runs body over [0, count) in chunks; the calling thread takes part, so
+    // this is safe to call from a worker of this pool.
+    void parallelFor(int count, const std::function<void(int, int)> &body);
+
+    int size() const;
+    // Index of the calling worker, or -1 when called from another thread.
+    int currentWorker() const;
+
+    // Pool view for Eigen devices; tasks scheduled through it are counted in
+    // the per-worker statistics like any other.
+    Eigen::ThreadPoolInterface *pool();
+
+    // Statistics per worker; the last entry collects work done by callers of
+    // parallelFor that are not pool threads.
+    std::vector<WorkerStats> stats() const;
+    void printStats(std::ostream &out) const;
+
+    // Routes cv::parallel_for_ through this pool (OpenCV 4.5.2 and later).
+    bool installOpenCVBackend();
+
+private:
+    Executor(int numThreads, const std::vector<int> &cpus);
+
+    void record(int worker, double busyMs);
+
+    struct Counters
+    {
+        std::atomic<long> tasks{0};
+        std::atomic<long> busyMicros{0};
+    };
+
+    class PoolView : public Eigen::ThreadPoolInterface
+    {
+    public:
+        explicit PoolView(Executor &executor) : executor(executor) {}
+        void Schedule(std::function<void()> fn) override { executor.schedule(std::move(fn)); }
+        int NumThreads() const override { return executor.size(); }
+        int CurrentThreadId() const override { return executor.currentWorker(); }
+
+    private:
+        Executor &executor;
+    };
+
+    std::unique_ptr<Counters[]> counters;
+    PoolView view{*this};
+    // Declared last so that tasks still drained by its destructor can record.
+    std::unique_ptr<PinnedThreadPool> threadPool;
+};
+
+#endif // EXECUTOR_H
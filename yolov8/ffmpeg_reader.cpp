@@ -0,0 +1,311 @@
+#include "ffmpeg_reader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#ifdef YOLOV8_WITH_FFMPEG
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+struct FFmpegReader::Context
+{
+    AVFormatContext *format{nullptr};
+    AVCodecContext *codec{nullptr};
+    SwsContext *scaler{nullptr};
+    SwsContext *fullScaler{nullptr};
+    SwsContext *yuvScaler{nullptr};
+    cv::Mat yuvPlanes;
+    AVPacket *packet{nullptr};
+    AVFrame *decoded{nullptr};
+    int stream{-1};
+    bool keyframesOnly{false};
+    bool draining{false};
+    cv::Size outputSize{};
+    bool letterbox{true};
+    cv::Size decodedSize{};
+
+    // Receives the next decoded frame into decoded, reading and sending
+    // packets as needed. Returns false at the end of the file.
+    bool decodeNext();
+    double timestamp() const;
+
+    ~Context()
+    {
+        sws_freeContext(scaler);
+        sws_freeContext(fullScaler);
+        sws_freeContext(yuvScaler);
+        av_frame_free(&decoded);
+        av_packet_free(&packet);
+        avcodec_free_context(&codec);
+        avformat_close_input(&format);
+    }
+};
+
+static std::string avError(int code)
+{
+    char message[AV_ERROR_MAX_STRING_SIZE] = {};
+    av_strerror(code, message, sizeof(message));
+    return message;
+}
+
+// Scales and converts decoded to BGR at size (native if empty), keeping the
+// aspect ratio on top-left black padding when letterbox is set.
+static SwsContext *convert(SwsContext *scaler, const AVFrame *decoded, cv::Mat &frame, const cv::Size &size, bool letterbox)
+{
+    cv::Size native(decoded->width, decoded->height);
+    cv::Size target = size.area() > 0 ? size : native;
+    cv::Size scaled = target;
+    if (letterbox && target != native)
+    {
+        double scale = std::min(double(target.width) / native.width, double(target.height) / native.height);
+        scaled = cv::Size(std::max(1, (int)std::lround(native.width * scale)), std::max(1, (int)std::lround(native.height * scale)));
+    }
+
+    scaler = sws_getCachedContext(scaler, native.width, native.height, (AVPixelFormat)decoded->format,
+                                  scaled.width, scaled.height, AV_PIX_FMT_BGR24,
+                                  SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!scaler)
+        throw std::runtime_error("Unsupported decoded pixel format");
+
+    frame.create(target.height, target.width, CV_8UC3);
+    cv::Mat picture = frame(cv::Rect(0, 0, scaled.width, scaled.height));
+    uint8_t *planes[] = {picture.data};
+    int strides[] = {(int)picture.step[0]};
+    sws_scale(scaler, decoded->data, decoded->linesize, 0, native.height, planes, strides);
+
+    // Pooled buffers come back with old pixels in them.
+    if (scaled.width < target.width)
+        frame.colRange(scaled.width, target.width).setTo(cv::Scalar::all(0));
+    if (scaled.height < target.height)
+        frame.rowRange(scaled.height, target.height).setTo(cv::Scalar::all(0));
+    return scaler;
+}
+
+FFmpegReader::FFmpegReader(const std::string &path, const FFmpegReaderOptions &options)
+    : context(std::make_unique<Context>())
+{
+    int status = avformat_open_input(&context->format, path.c_str(), nullptr, nullptr);
+    if (status < 0)
+        throw std::runtime_error("Could not open video file " + path + ": " + avError(status));
+    status = avformat_find_stream_info(context->format, nullptr);
+    if (status < 0)
+        throw std::runtime_error("Could not read stream info of " + path + ": " + avError(status));
+
+    const AVCodec *decoder = nullptr;
+    context->stream = av_find_best_stream(context->format, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+    if (context->stream < 0 || !decoder)
+        throw std::runtime_error("No decodable video stream in " + path);
+
+    // Audio and other streams are dropped before they are even read.
+    for (unsigned i = 0; i < context->format->nb_streams; ++i)
+        if ((int)i != context->stream)
+            context->format->streams[i]->discard = AVDISCARD_ALL;
+
+    AVStream *stream = context->format->streams[context->stream];
+    context->codec = avcodec_alloc_context3(decoder);
+    if (!context->codec)
+        throw std::runtime_error("Could not allocate a decoder for " + path);
+    avcodec_parameters_to_context(context->codec, stream->codecpar);
+    context->codec->thread_count = options.decodeThreads;
+    context->codec->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+    context->keyframesOnly = options.keyframesOnly;
+    context->outputSize = options.outputSize;
+    context->letterbox = options.letterbox;
+    if (options.keyframesOnly)
+    {
+        stream->discard = AVDISCARD_NONKEY;
+        context->codec->skip_frame = AVDISCARD_NONKEY;
+    }
+
+    status = avcodec_open2(context->codec, decoder, nullptr);
+    if (status < 0)
+        throw std::runtime_error("Could not open the decoder for " + path + ": " + avError(status));
+
+    context->packet = av_packet_alloc();
+    context->decoded = av_frame_alloc();
+}
+
+FFmpegReader::~FFmpegReader() = default;
+
+bool FFmpegReader::Context::decodeNext()
+{
+    while (true)
+    {
+        int status = avcodec_receive_frame(codec, decoded);
+        if (status == 0)
+            break;
+        if (status == AVERROR_EOF || (status == AVERROR(EAGAIN) && draining))
+            return false;
+        if (status != AVERROR(EAGAIN))
+            throw std::runtime_error("Video decoding failed: " + avError(status));
+
+        if (av_read_frame(format, packet) < 0)
+        {
+            // End of file: flush the frames the decoder still holds.
+            draining = true;
+            avcodec_send_packet(codec, nullptr);
+            continue;
+        }
+        // Not every demuxer honours AVDISCARD_NONKEY, so check the flag too.
+        // A corrupt packet is skipped rather than ending the stream.
+        if (packet->stream_index == stream && (!keyframesOnly || (packet->flags & AV_PKT_FLAG_KEY)))
+            avcodec_send_packet(codec, packet);
+        av_packet_unref(packet);
+    }
+    decodedSize = cv::Size(decoded->width, decoded->height);
+    return true;
+}
+
+bool FFmpegReader::read(cv::Mat &frame, double &timestamp)
+{
+    return read(frame, nullptr, timestamp);
+}
+
+bool FFmpegReader::read(cv::Mat &frame, cv::Mat *fullFrame, double &timestamp)
+{
+    Context &c = *context;
+    if (!c.decodeNext())
+        return false;
+
+    AVFrame *decoded = c.decoded;
+    c.scaler = convert(c.scaler, decoded, frame, c.outputSize, c.letterbox);
+    if (fullFrame)
+        c.fullScaler = convert(c.fullScaler, decoded, *fullFrame, cv::Size(), false);
+
+    timestamp = c.timestamp();
+    av_frame_unref(decoded);
+    return true;
+}
+
+bool FFmpegReader::readYuv(YuvImage &image, cv::Mat *fullFrame, double &timestamp)
+{
+    Context &c = *context;
+    if (!c.decodeNext())
+        return false;
+
+    // The decoded frame is kept until the next receive, which releases it.
+    AVFrame *decoded = c.decoded;
+    image.width = decoded->width;
+    image.height = decoded->height;
+    if (decoded->format == AV_PIX_FMT_YUV420P || decoded->format == AV_PIX_FMT_NV12)
+    {
+        image.layout = decoded->format == AV_PIX_FMT_NV12 ? YuvLayout::NV12 : YuvLayout::I420;
+        image.y = decoded->data[0];
+        image.yStride = decoded->linesize[0];
+        image.u = decoded->data[1];
+        image.uStride = decoded->linesize[1];
+        image.v = image.layout == YuvLayout::I420 ? decoded->data[2] : nullptr;
+        image.vStride = image.layout == YuvLayout::I420 ? decoded->linesize[2] : 0;
+    }
+    else
+    {
+        int chromaWidth = (decoded->width + 1) / 2;
+        int chromaHeight = (decoded->height + 1) / 2;
+        c.yuvScaler = sws_getCachedContext(c.yuvScaler, decoded->width, decoded->height, (AVPixelFormat)decoded->format,
+                                           decoded->width, decoded->height, AV_PIX_FMT_YUV420P,
+                                           SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!c.yuvScaler)
+            throw std::runtime_error("Unsupported decoded pixel format");
+        // One buffer: the luma rows, then rows holding a U row and a V row side by side.
+        c.yuvPlanes.create(decoded->height + chromaHeight, 2 * chromaWidth, CV_8UC1);
+        uint8_t *planes[] = {c.yuvPlanes.data, c.yuvPlanes.ptr(decoded->height), c.yuvPlanes.ptr(decoded->height) + chromaWidth};
+        int strides[] = {(int)c.yuvPlanes.step[0], (int)c.yuvPlanes.step[0], (int)c.yuvPlanes.step[0]};
+        sws_scale(c.yuvScaler, decoded->data, decoded->linesize, 0, decoded->height, planes, strides);
+
+        image.layout = YuvLayout::I420;
+        image.y = planes[0];
+        image.yStride = strides[0];
+        image.u = planes[1];
+        image.uStride = strides[1];
+        image.v = planes[2];
+        image.vStride = strides[2];
+    }
+    if (fullFrame)
+        c.fullScaler = convert(c.fullScaler, decoded, *fullFrame, cv::Size(), false);
+
+    timestamp = c.timestamp();
+    return true;
+}
+
+double FFmpegReader::Context::timestamp() const
+{
+    const AVStream *videoStream = format->streams[stream];
+    int64_t pts = decoded->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE)
+        return -1.0;
+    return (pts - (videoStream->start_time == AV_NOPTS_VALUE ? 0 : videoStream->start_time)) * av_q2d(videoStream->time_base);
+}
+
+bool FFmpegReader::skip()
+{
+    if (!context->decodeNext())
+        return false;
+    av_frame_unref(context->decoded);
+    return true;
+}
+
+double FFmpegReader::frameRate() const
+{
+    const AVStream *stream = context->format->streams[context->stream];
+    AVRational rate = stream->avg_frame_rate.num ? stream->avg_frame_rate : stream->r_frame_rate;
+    return rate.den ? av_q2d(rate) : 0.0;
+}
+
+cv::Size FFmpegReader::frameSize() const
+{
+    if (context->decodedSize.area() > 0)
+        return context->decodedSize;
+    const AVCodecParameters *parameters = context->format->streams[context->stream]->codecpar;
+    return cv::Size(parameters->width, parameters->height);
+}
+
+#else
+
+struct FFmpegReader::Context
+{
+};
+
+FFmpegReader::FFmpegReader(const std::string &path, const FFmpegReaderOptions &)
+{
+    throw std::runtime_error("Cannot read " + path + ": FFmpeg reader not compiled in (YOLOV8_WITH_FFMPEG)");
+}
+
+FFmpegReader::~FFmpegReader() = default;
+
+bool FFmpegReader::read(cv::Mat &, double &)
+{
+    return false;
+}
+
+bool FFmpegReader::read(cv::Mat &, cv::Mat *, double &)
+{
+    return false;
+}
+
+bool FFmpegReader::readYuv(YuvImage &, cv::Mat *, double &)
+{
+    return false;
+}
+
+bool FFmpegReader::skip()
+{
+    return false;
+}
+
+double FFmpegReader::frameRate() const
+{
+    return 0.0;
+}
+
+cv::Size FFmpegReader::frameSize() const
+{
+    return cv::Size();
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef FFMPEG_READER_H
+#define FFMPEG_READER_H
+
+// Cpp native
+#include <memory>
+#include <string>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+#include "yuv_preprocess.h"
+
+struct FFmpegReaderOptions
+{
+    // Decode keyframes only. Non-key packets are discarded by the demuxer (or
+    // right after it) and never reach the decoder, so P/B-frame decoding is
+    // skipped entirely.
+    bool keyframesOnly{false};
+    // libavcodec decoding threads, 0 picks one per core.
+    int decodeThreads{0};
+
+    // Size read() scales to, e.g. the network input or a preview size; empty
+    // for the native resolution. Scaling and colour conversion are one
+    // swscale pass. With letterbox the aspect ratio is kept and the picture
+    // sits top-left on black padding, the way Inference letterboxes square
+    // models, so the result can go into a PreparedFrame as it is.
+    cv::Size outputSize{};
+    bool letterbox{true};
+};
+
+// Video file reader on libavformat/libavcodec, for the modes cv::VideoCapture
+// cannot express. Only functional in builds with YOLOV8_WITH_FFMPEG; elsewhere
+// the constructor throws.
+class FFmpegReader
+{
+public:
+    FFmpegReader(const std::string &path, const FFmpegReaderOptions &options = {});
+    ~FFmpegReader();
+
+    FFmpegReader(const FFmpegReader &) = delete;
+    FFmpegReader &operator=(const FFmpegReader &) = delete;
+
+    // Decodes the next frame as BGR at the options' outputSize into frame,
+    // reallocating it unless it already has the right size and type.
+    // timestamp is the frame's presentation time in seconds from the start
+    // of the stream (-1 if the file has none). Returns false at the end of
+    // the file.
+    bool read(cv::Mat &frame, double &timestamp);
+
+    // As above; fullFrame, when not null, also receives the frame in BGR at
+    // full resolution (only worth its cost when something draws on it).
+    bool read(cv::Mat &frame, cv::Mat *fullFrame, double &timestamp);
+
+    // Decodes the next frame and exposes its 4:2:0 planes without any
+    // conversion (decoders of other formats go through one swscale pass to
+    // I420). The planes stay valid until the next call. fullFrame as for
+    // read(). Returns false at the end of the file.
+    bool readYuv(YuvImage &image, cv::Mat *fullFrame, double &timestamp);
+
+    // Decodes the next frame without converting it, for frames that are
+    // sampled out. Returns false at the end of the file.
+    bool skip();
+
+    double frameRate() const;
+    // Native size of the most recently decoded frame (of the stream before
+    // the first read).
+    cv::Size frameSize() const;
+
+private:
+    struct Context;
+    std::unique_ptr<Context> context;
+};
+
+#endif // FFMPEG_READER_H
@@ -0,0 +1,505 @@
+#include "file_io.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef YOLOV8_WITH_LIBURING
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+FileIOOptions requestedOptions;
+std::atomic<bool> created{false};
+
+bool readWhole(const std::string &path, std::vector<uint8_t> &data, std::string &error)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        error = "Could not open " + path;
+        return false;
+    }
+    std::streamoff size = file.tellg();
+    data.resize((size_t)std::max<std::streamoff>(size, 0));
+    file.seekg(0);
+    if (!data.empty() && !file.read(reinterpret_cast<char *>(data.data()), (std::streamsize)data.size()))
+    {
+        error = "Could not read " + path;
+        return false;
+    }
+    return true;
+}
+
+bool writeWhole(const std::string &path, const std::vector<uint8_t> &data, bool append, std::string &error)
+{
+    std::ofstream file(path, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+    if (!file || !file.write(reinterpret_cast<const char *>(data.data()), (std::streamsize)data.size()))
+    {
+        error = "Could not write " + path;
+        return false;
+    }
+    return true;
+}
+
+#ifdef YOLOV8_WITH_LIBURING
+// OPENAT, READ and WRITE arrived in Linux 5.6: older kernels set up a ring
+// but fail every such request with EINVAL. Probing needs 5.6 as well, so a
+// failed probe means they are missing too.
+bool ringSupportsRequests(io_uring *ring)
+{
+    io_uring_probe *probe = io_uring_get_probe_ring(ring);
+    if (!probe)
+        return false;
+    bool supported = io_uring_opcode_supported(probe, IORING_OP_OPENAT) &&
+                     io_uring_opcode_supported(probe, IORING_OP_READ) &&
+                     io_uring_opcode_supported(probe, IORING_OP_WRITE);
+    io_uring_free_probe(probe);
+    return supported;
+}
+#endif
+}
+
+#ifdef YOLOV8_WITH_LIBURING
+
+// One read or write: open, one or more transfers, close.
+struct FileIORequest
+{
+    bool writing{false};
+    bool append{false};
+    bool opened{false};
+    std::string path;
+    int fd{-1};
+    std::vector<uint8_t> data;
+    size_t done{0};    // bytes transferred
+    size_t pending{0}; // bytes in the transfer in flight
+    int buffer{-1};    // registered buffer, -1 for none
+    ReadCallback onRead;
+    WriteCallback onWrite;
+};
+
+struct FileIO::Ring
+{
+    io_uring ring{};
+    size_t bufferSize{0};
+    std::vector<uint8_t> bufferMemory;
+    std::vector<int> freeBuffers;
+    unsigned depth{0};
+    unsigned inFlight{0};
+    std::deque<FileIORequest *> backlog;
+    std::mutex mutex; // guards everything above once the reaper runs
+    std::condition_variable drained;
+    std::thread reaper;
+
+    ~Ring()
+    {
+        if (!reaper.joinable())
+            return;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            drained.wait(lock, [this] { return inFlight == 0 && backlog.empty(); });
+            // A request without data stops the reaper.
+            io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_nop(sqe);
+            io_uring_sqe_set_data(sqe, nullptr);
+            io_uring_submit(&ring);
+        }
+        reaper.join();
+        io_uring_queue_exit(&ring);
+    }
+
+    // Queues the next step of request, or parks it while the ring is full.
+    void submitLocked(FileIORequest *request)
+    {
+        if (inFlight >= depth)
+        {
+            backlog.push_back(request);
+            return;
+        }
+
+        io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        if (!request->opened)
+        {
+            int flags = O_CLOEXEC | (request->writing ? O_WRONLY | O_CREAT | (request->append ? O_APPEND : O_TRUNC) : O_RDONLY);
+            io_uring_prep_openat(sqe, AT_FDCWD, request->path.c_str(), flags, 0644);
+        }
+        else
+        {
+            if (request->buffer < 0 && !freeBuffers.empty() && (!request->writing || request->data.size() - request->done <= bufferSize))
+            {
+                request->buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+            }
+            uint8_t *fixed = request->buffer < 0 ? nullptr : bufferMemory.data() + request->buffer * bufferSize;
+
+            if (request->writing)
+            {
+                request->pending = std::min(request->data.size() - request->done, fixed ? bufferSize : request->data.size());
+                if (fixed)
+                {
+                    std::memcpy(fixed, request->data.data() + request->done, request->pending);
+                    io_uring_prep_write_fixed(sqe, request->fd, fixed, (unsigned)request->pending, request->done, request->buffer);
+                }
+                else
+                {
+                    io_uring_prep_write(sqe, request->fd, request->data.data() + request->done, (unsigned)request->pending, request->done);
+                }
+            }
+            else
+            {
+                request->pending = bufferSize;
+                if (fixed)
+                {
+                    io_uring_prep_read_fixed(sqe, request->fd, fixed, (unsigned)request->pending, request->done, request->buffer);
+                }
+                else
+                {
+                    request->data.resize(request->done + request->pending);
+                    io_uring_prep_read(sqe, request->fd, request->data.data() + request->done, (unsigned)request->pending, request->done);
+                }
+            }
+        }
+        io_uring_sqe_set_data(sqe, request);
+        io_uring_submit(&ring);
+        inFlight++;
+    }
+
+    // Closes the file and reports the outcome, outside the lock.
+    void finish(FileIORequest *request, const std::string &error)
+    {
+        if (request->fd >= 0)
+            ::close(request->fd);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (request->buffer >= 0)
+                freeBuffers.push_back(request->buffer);
+        }
+        if (request->writing)
+        {
+            request->onWrite(error);
+        }
+        else
+        {
+            request->data.resize(error.empty() ? request->done : 0);
+            request->onRead(std::move(request->data), error);
+        }
+        delete request;
+    }
+
+    void complete(FileIORequest *request, int result)
+    {
+        if (result < 0)
+        {
+            finish(request, (request->opened ? "I/O error on " : "Could not open ") + request->path + ": " + std::strerror(-result));
+            return;
+        }
+
+        bool more = false;
+        if (!request->opened)
+        {
+            request->opened = true;
+            request->fd = result;
+            more = !request->writing || !request->data.empty();
+        }
+        else if (request->writing)
+        {
+            request->done += (size_t)result;
+            more = request->done < request->data.size();
+        }
+        else
+        {
+            if (request->buffer >= 0)
+            {
+                request->data.resize(request->done + (size_t)result);
+                std::memcpy(request->data.data() + request->done, bufferMemory.data() + request->buffer * bufferSize, (size_t)result);
+            }
+            request->done += (size_t)result;
+            // A short read of a regular file is its end, which saves the
+            // extra zero-length read per file.
+            more = (size_t)result == request->pending;
+        }
+
+        if (!more)
+        {
+            finish(request, "");
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        submitLocked(request);
+    }
+
+    void reap()
+    {
+        while (true)
+        {
+            io_uring_cqe *cqe = nullptr;
+            if (io_uring_wait_cqe(&ring, &cqe) < 0)
+                continue;
+            auto *request = static_cast<FileIORequest *>(io_uring_cqe_get_data(cqe));
+            int result = cqe->res;
+            io_uring_cqe_seen(&ring, cqe);
+            if (!request)
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inFlight--;
+            }
+            complete(request, result);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!backlog.empty() && inFlight < depth)
+            {
+                FileIORequest *next = backlog.front();
+                backlog.pop_front();
+                submitLocked(next);
+            }
+            if (inFlight == 0 && backlog.empty())
+                drained.notify_all();
+        }
+    }
+};
+
+#else
+
+struct FileIO::Ring
+{
+};
+
+#endif
+
+void FileIO::configure(const FileIOOptions &options)
+{
+    if (created)
+        std::cerr << "Warning: FileIO::configure called after the I/O layer was created; ignored." << std::endl;
+    requestedOptions = options;
+}
+
+FileIO &FileIO::instance()
+{
+    static FileIO io(requestedOptions);
+    return io;
+}
+
+FileIO::FileIO(const FileIOOptions &options)
+{
+    created = true;
+#ifdef YOLOV8_WITH_LIBURING
+    auto candidate = std::make_unique<Ring>();
+    candidate->depth = std::max(1u, options.queueDepth);
+    int status = io_uring_queue_init(candidate->depth, &candidate->ring, 0);
+    std::string reason = status == 0 ? "" : std::strerror(-status);
+    if (status == 0 && !ringSupportsRequests(&candidate->ring))
+    {
+        // The reaper never started, so ~Ring leaves the ring to us.
+        io_uring_queue_exit(&candidate->ring);
+        reason = "kernel lacks openat/read/write requests";
+        status = -1;
+    }
+    if (status == 0)
+    {
+        // Registration needs locked memory; without it transfers just go
+        // through unregistered memory.
+        candidate->bufferSize = std::max<size_t>(options.bufferSize, 4096);
+        size_t bufferSize = candidate->bufferSize;
+        candidate->bufferMemory.resize(options.registeredBuffers * bufferSize);
+        std::vector<iovec> vectors(options.registeredBuffers);
+        for (unsigned i = 0; i < options.registeredBuffers; ++i)
+            vectors[i] = {candidate->bufferMemory.data() + i * bufferSize, bufferSize};
+        if (!vectors.empty() && io_uring_register_buffers(&candidate->ring, vectors.data(), (unsigned)vectors.size()) == 0)
+        {
+            for (int i = (int)vectors.size() - 1; i >= 0; --i)
+                candidate->freeBuffers.push_back(i);
+        }
+        else
+        {
+            candidate->bufferMemory.clear();
+            candidate->bufferMemory.shrink_to_fit();
+        }
+        Ring *started = candidate.get();
+        candidate->reaper = std::thread([started] { started->reap(); });
+        ring = std::move(candidate);
+        return;
+    }
+    std::cerr << "Warning: io_uring not available (" << reason << "), using blocking I/O threads." << std::endl;
+#endif
+    for (int i = 0; i < std::max(1, options.fallbackThreads); ++i)
+        threads.emplace_back([this] { fallbackLoop(); });
+}
+
+FileIO::~FileIO()
+{
+    ring.reset();
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+void FileIO::fallbackLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(taskMutex);
+            taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void FileIO::read(const std::string &path, ReadCallback done)
+{
+#ifdef YOLOV8_WITH_LIBURING
+    if (ring)
+    {
+        auto *request = new FileIORequest();
+        request->path = path;
+        request->onRead = std::move(done);
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        ring->submitLocked(request);
+        return;
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        tasks.push_back([path, done = std::move(done)] {
+            std::vector<uint8_t> data;
+            std::string error;
+            readWhole(path, data, error);
+            done(std::move(data), error);
+        });
+    }
+    taskReady.notify_one();
+}
+
+void FileIO::write(const std::string &path, std::vector<uint8_t> data, bool append, WriteCallback done)
+{
+#ifdef YOLOV8_WITH_LIBURING
+    if (ring)
+    {
+        auto *request = new FileIORequest();
+        request->writing = true;
+        request->append = append;
+        request->path = path;
+        request->data = std::move(data);
+        request->onWrite = std::move(done);
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        ring->submitLocked(request);
+        return;
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        tasks.push_back([path, data = std::move(data), append, done = std::move(done)] {
+            std::string error;
+            writeWhole(path, data, append, error);
+            done(error);
+        });
+    }
+    taskReady.notify_one();
+}
+
+std::future<std::vector<uint8_t>> FileIO::read(const std::string &path)
+{
+    auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+    read(path, [promise](std::vector<uint8_t> &&data, const std::string &error) {
+        if (error.empty())
+            promise->set_value(std::move(data));
+        else
+            promise->set_exception(std::make_exception_ptr(std::runtime_error(error)));
+    });
+    return promise->get_future();
+}
+
+std::future<void> FileIO::write(const std::string &path, std::vector<uint8_t> data, bool append)
+{
+    auto promise = std::make_shared<std::promise<void>>();
+    write(path, std::move(data), append, [promise](const std::string &error) {
+        if (error.empty())
+            promise->set_value();
+        else
+            promise->set_exception(std::make_exception_ptr(std::runtime_error(error)));
+    });
+    return promise->get_future();
+}
+
+const char *FileIO::backend() const
+{
+    return ring ? "io_uring" : "threads";
+}
+
+AsyncLogWriter::AsyncLogWriter(const std::string &path, bool truncate)
+    : path(path), append(!truncate)
+{
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    try
+    {
+        flush();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Warning: " << e.what() << std::endl;
+    }
+}
+
+void AsyncLogWriter::write(const std::string &text)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pending += text;
+    if (!busy)
+        startLocked();
+}
+
+void AsyncLogWriter::startLocked()
+{
+    busy = true;
+    std::vector<uint8_t> data(pending.begin(), pending.end());
+    pending.clear();
+    bool appending = append;
+    append = true;
+    FileIO::instance().write(path, std::move(data), appending, [this](const std::string &failure) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failure.empty() && error.empty())
+            error = failure;
+        if (!pending.empty())
+        {
+            startLocked();
+            return;
+        }
+        busy = false;
+        idle.notify_all();
+    });
+}
+
+void AsyncLogWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!busy && !pending.empty())
+        startLocked();
+    idle.wait(lock, [this] { return !busy; });
+    if (!error.empty())
+    {
+        std::string failure = error;
+        error.clear();
+        throw std::runtime_error(failure);
+    }
+}
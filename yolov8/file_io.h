@@ -0,0 +1,109 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+// Cpp native
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FileIOOptions
+{
+    // Operations in flight at once (io_uring submission queue entries).
+    // Requests beyond it wait in a backlog; submitting never blocks.
+    unsigned queueDepth{64};
+    // Buffers registered with the kernel once, so transfers through them skip
+    // the per-operation page pinning. Files up to bufferSize go through one
+    // of them when one is free, larger ones directly to their own memory.
+    unsigned registeredBuffers{32};
+    size_t bufferSize{1 << 20};
+    // Blocking I/O threads when io_uring is not available (not compiled in,
+    // refused by the kernel or a seccomp policy, or a kernel older than 5.6
+    // that lacks the openat/read/write requests).
+    int fallbackThreads{4};
+};
+
+// Callbacks run on the I/O completion thread: keep them short and hand real
+// work to the Executor. error is empty on success.
+using ReadCallback = std::function<void(std::vector<uint8_t> &&data, const std::string &error)>;
+using WriteCallback = std::function<void(const std::string &error)>;
+
+// Process-wide asynchronous whole-file reads and writes: input images, model
+// files, detection logs, crops. Uses io_uring in builds with
+// YOLOV8_WITH_LIBURING and a small blocking thread pool otherwise.
+class FileIO
+{
+public:
+    // Must be called before the first instance().
+    static void configure(const FileIOOptions &options);
+    static FileIO &instance();
+    ~FileIO();
+
+    FileIO(const FileIO &) = delete;
+    FileIO &operator=(const FileIO &) = delete;
+
+    void read(const std::string &path, ReadCallback done);
+    // Replaces the file, or appends to it. Concurrent appends to one file are
+    // not ordered; AsyncLogWriter keeps them in sequence.
+    void write(const std::string &path, std::vector<uint8_t> data, bool append, WriteCallback done);
+
+    // Future versions of the above; errors arrive as std::runtime_error.
+    std::future<std::vector<uint8_t>> read(const std::string &path);
+    std::future<void> write(const std::string &path, std::vector<uint8_t> data, bool append = false);
+
+    // "io_uring" or "threads".
+    const char *backend() const;
+
+private:
+    explicit FileIO(const FileIOOptions &options);
+
+    void fallbackLoop();
+
+    struct Ring;
+    std::unique_ptr<Ring> ring;
+
+    // Thread pool fallback.
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex taskMutex;
+    std::condition_variable taskReady;
+    bool stopping{false};
+};
+
+// Appends text to one file in order without blocking the caller. Text written
+// while a write is in flight is collected and goes out with the next one, so
+// many small lines become few large writes.
+class AsyncLogWriter
+{
+public:
+    // truncate replaces an existing file with the first write.
+    explicit AsyncLogWriter(const std::string &path, bool truncate = true);
+    ~AsyncLogWriter();
+
+    AsyncLogWriter(const AsyncLogWriter &) = delete;
+    AsyncLogWriter &operator=(const AsyncLogWriter &) = delete;
+
+    void write(const std::string &text);
+    // Waits until everything written so far is in the file; throws if a
+    // write failed.
+    void flush();
+
+private:
+    void startLocked();
+
+    std::string path;
+    bool append;
+    std::string pending;
+    bool busy{false};
+    std::string error;
+    std::mutex mutex;
+    std::condition_variable idle;
+};
+
+#endif // FILE_IO_H
@@ -1,148 +1,237 @@
 #include "inference.h"
 
-Inference::Inference(const std::string &onnxModelPath, const cv::Size &modelInputShape, const std::string &classesTxtFile, const bool &runWithCuda)
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+// Static initialisation runs before main, close enough to process start for
+// time-to-first-detection.
+const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+
+double msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
+Inference::Inference(const std::string &onnxModelPath, const cv::Size &modelInputShape, const std::string &classesTxtFile, const bool &runWithCuda, const BackendOptions &backendOptions)
 {
     modelPath = onnxModelPath;
     modelShape = modelInputShape;
     classesPath = classesTxtFile;
     cudaEnabled = runWithCuda;
+    this->backendOptions = backendOptions;
 
     loadOnnxNetwork();
     // loadClassesFromFile(); The classes are hard-coded for this example
+    classTable = std::make_shared<const ClassTable>(classes);
 }
 
 std::vector<Detection> Inference::runInference(const cv::Mat &input)
 {
-    cv::Mat modelInput = input;
-    if (letterBoxForSquare && modelShape.width == modelShape.height)
-        modelInput = formatToSquare(modelInput);
+    runInference(input, compact);
 
-    cv::Mat blob;
-    cv::dnn::blobFromImage(modelInput, blob, 1.0/255.0, modelShape, cv::Scalar(), true, false);
-    net.setInput(blob);
+    std::vector<Detection> detections{};
+    detections.reserve(compact.size());
+    for (const CompactDetection &detection : compact)
+        detections.push_back(toDetection(detection, *classTable));
 
-    std::vector<cv::Mat> outputs;
-    net.forward(outputs, net.getUnconnectedOutLayersNames());
+    return detections;
+}
 
-    int rows = outputs[0].size[1];
-    int dimensions = outputs[0].size[2];
+void Inference::runInference(const cv::Mat &input, DetectionBatch &batch)
+{
+    runInference(input, compact);
 
-    bool yolov8 = false;
-    // yolov5 has an output of shape (batchSize, 25200, 85) (Num classes + box[x,y,w,h] + confidence[c])
-    // yolov8 has an output of shape (batchSize, 84,  8400) (Num classes + box[x,y,w,h])
-    if (dimensions > rows) // Check if the shape[2] is more than shape[1] (yolov8)
-    {
-        yolov8 = true;
-        rows = outputs[0].size[2];
-        dimensions = outputs[0].size[1];
+    batch.clear();
+    for (const CompactDetection &detection : compact)
+        batch.push(detection);
+}
+
+std::vector<Detection> Inference::runInference(const PreparedFrame &frame)
+{
+    runInference(frame, compact);
+
+    std::vector<Detection> detections{};
+    detections.reserve(compact.size());
+    for (const CompactDetection &detection : compact)
+        detections.push_back(toDetection(detection, *classTable));
+
+    return detections;
+}
 
-        outputs[0] = outputs[0].reshape(1, dimensions);
-        cv::transpose(outputs[0], outputs[0]);
+void Inference::runInference(const cv::Mat &input, std::vector<CompactDetection> &detections)
+{
+    runInference(prepare(input), detections);
+}
+
+void Inference::runInference(const PreparedFrame &frame, std::vector<CompactDetection> &detections)
+{
+    runCascade(frame, detections);
+    recordFirstDetection();
+}
+
+// The escalation model is run through runModel() directly, so only the
+// primary records startup stats and a cascade's first detection is the one
+// it returns.
+void Inference::runCascade(const PreparedFrame &frame, std::vector<CompactDetection> &detections)
+{
+    if (!escalation)
+    {
+        runModel(frame, detections, modelScoreThreshold);
+        return;
     }
-    float *data = (float *)outputs[0].data;
 
-    float x_factor = modelInput.cols / modelShape.width;
-    float y_factor = modelInput.rows / modelShape.height;
+    // Decode the primary model down to the bottom of the uncertainty band so
+    // borderline boxes are visible to the escalation check.
+    auto start = std::chrono::steady_clock::now();
+    runModel(frame, detections, std::min(cascadeOptions.uncertainLow, modelScoreThreshold));
+    double primaryMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-    std::vector<int> class_ids;
-    std::vector<float> confidences;
-    std::vector<cv::Rect> boxes;
+    cascadeStats.frames++;
+    cascadeStats.primaryMsTotal += primaryMs;
+    cascadeStats.primaryMsMax = std::max(cascadeStats.primaryMsMax, primaryMs);
 
-    for (int i = 0; i < rows; ++i)
+    if (shouldEscalate(detections))
     {
-        if (yolov8)
-        {
-            float *classes_scores = data+4;
+        start = std::chrono::steady_clock::now();
+        escalation->runModel(frame, detections, escalation->modelScoreThreshold);
+        double escalatedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        cascadeStats.escalations++;
+        cascadeStats.escalatedMsTotal += escalatedMs;
+        cascadeStats.escalatedMsMax = std::max(cascadeStats.escalatedMsMax, escalatedMs);
+        return;
+    }
 
-            cv::Mat scores(1, classes.size(), CV_32FC1, classes_scores);
-            cv::Point class_id;
-            double maxClassScore;
+    detections.erase(std::remove_if(detections.begin(), detections.end(),
+                                    [this](const CompactDetection &d) { return d.score <= modelScoreThreshold; }),
+                     detections.end());
+}
 
-            minMaxLoc(scores, 0, &maxClassScore, 0, &class_id);
+bool Inference::shouldEscalate(const std::vector<CompactDetection> &detections) const
+{
+    for (const CompactDetection &detection : detections)
+    {
+        if (detection.score >= cascadeOptions.uncertainLow && detection.score < cascadeOptions.uncertainHigh)
+            return true;
+        if (std::find(cascadeOptions.escalateClasses.begin(), cascadeOptions.escalateClasses.end(),
+                      detection.classId) != cascadeOptions.escalateClasses.end())
+            return true;
+    }
+    return false;
+}
 
-            if (maxClassScore > modelScoreThreshold)
-            {
-                confidences.push_back(maxClassScore);
-                class_ids.push_back(class_id.x);
+void Inference::runModel(const PreparedFrame &frame, std::vector<CompactDetection> &detections, float scoreThreshold)
+{
+    // blobFromImage only resizes when the image is not the model size yet.
+    cv::Mat blob = frame.blob;
+    if (blob.empty())
+        cv::dnn::blobFromImage(frame.image, blob, 1.0/255.0, modelShape, cv::Scalar(), true, false);
+    else if (blob.dims != 4 || blob.size[2] != (int)modelShape.height || blob.size[3] != (int)modelShape.width)
+        throw std::runtime_error("Prepared blob does not match the input size of " + modelPath);
 
-                float x = data[0];
-                float y = data[1];
-                float w = data[2];
-                float h = data[3];
+    std::vector<cv::Mat> outputs;
+    backend->forward(blob, outputs);
 
-                int left = int((x - 0.5 * w) * x_factor);
-                int top = int((y - 0.5 * h) * y_factor);
+    decodeOutput((const float *)outputs[0].data, coveredSize(frame.sourceSize), detections, scoreThreshold);
+}
 
-                int width = int(w * x_factor);
-                int height = int(h * y_factor);
+PreparedFrame Inference::prepare(const cv::Mat &input)
+{
+    PreparedFrame frame;
+    frame.image = letterBoxForSquare && modelShape.width == modelShape.height ? formatToSquare(input) : input;
+    frame.sourceSize = input.size();
+    return frame;
+}
 
-                boxes.push_back(cv::Rect(left, top, width, height));
-            }
-        }
-        else // yolov5
-        {
-            float confidence = data[4];
+// Size of the source frame once letterboxed, i.e. the area the model input
+// stands for.
+cv::Size Inference::coveredSize(const cv::Size &sourceSize) const
+{
+    if (letterBoxForSquare && modelShape.width == modelShape.height)
+    {
+        int side = std::max(sourceSize.width, sourceSize.height);
+        return cv::Size(side, side);
+    }
+    return sourceSize;
+}
 
-            if (confidence >= modelConfidenceThreshold)
-            {
-                float *classes_scores = data+5;
+void Inference::runInference(const std::vector<cv::Mat> &inputs, std::vector<std::vector<CompactDetection>> &results)
+{
+    std::vector<PreparedFrame> frames;
+    frames.reserve(inputs.size());
+    for (const cv::Mat &input : inputs)
+        frames.push_back(prepare(input));
 
-                cv::Mat scores(1, classes.size(), CV_32FC1, classes_scores);
-                cv::Point class_id;
-                double max_class_score;
+    runInference(frames, results);
+}
 
-                minMaxLoc(scores, 0, &max_class_score, 0, &class_id);
+void Inference::runInference(const std::vector<PreparedFrame> &frames, std::vector<std::vector<CompactDetection>> &results)
+{
+    results.resize(frames.size());
 
-                if (max_class_score > modelScoreThreshold)
-                {
-                    confidences.push_back(confidence);
-                    class_ids.push_back(class_id.x);
+    // The cascade decides per frame, so batching does not apply to it; nor
+    // to frames that bring their own blob.
+    bool ownBlobs = std::any_of(frames.begin(), frames.end(), [](const PreparedFrame &frame) { return !frame.blob.empty(); });
+    if (escalation || ownBlobs || frames.size() < 2)
+    {
+        for (size_t i = 0; i < frames.size(); ++i)
+            runInference(frames[i], results[i]);
+        return;
+    }
 
-                    float x = data[0];
-                    float y = data[1];
-                    float w = data[2];
-                    float h = data[3];
+    std::vector<cv::Mat> modelInputs;
+    modelInputs.reserve(frames.size());
+    for (const PreparedFrame &frame : frames)
+        modelInputs.push_back(frame.image);
 
-                    int left = int((x - 0.5 * w) * x_factor);
-                    int top = int((y - 0.5 * h) * y_factor);
+    cv::Mat blob;
+    cv::dnn::blobFromImages(modelInputs, blob, 1.0/255.0, modelShape, cv::Scalar(), true, false);
 
-                    int width = int(w * x_factor);
-                    int height = int(h * y_factor);
+    std::vector<cv::Mat> outputs;
+    backend->forward(blob, outputs);
 
-                    boxes.push_back(cv::Rect(left, top, width, height));
-                }
-            }
-        }
+    if (outputs[0].dims != 3 || outputs[0].size[0] != (int)frames.size())
+        throw std::runtime_error("Model " + modelPath + " does not accept a batch of " + std::to_string(frames.size()));
 
-        data += dimensions;
-    }
+    for (size_t i = 0; i < frames.size(); ++i)
+        decodeOutput(outputs[0].ptr<float>((int)i), coveredSize(frames[i].sourceSize), results[i], modelScoreThreshold);
+    recordFirstDetection();
+}
 
-    std::vector<int> nms_result;
-    cv::dnn::NMSBoxes(boxes, confidences, modelScoreThreshold, modelNMSThreshold, nms_result);
+void Inference::decodeOutput(const float *data, const cv::Size &inputSize, std::vector<CompactDetection> &detections, float scoreThreshold)
+{
+    DecodeParams params;
+    params.rows = outputRows;
+    params.numClasses = outputClasses;
+    params.xFactor = inputSize.width / modelShape.width;
+    params.yFactor = inputSize.height / modelShape.height;
+    params.confidenceThreshold = modelConfidenceThreshold;
+    params.scoreThreshold = scoreThreshold;
 
-    std::vector<Detection> detections{};
-    for (unsigned long i = 0; i < nms_result.size(); ++i)
-    {
-        int idx = nms_result[i];
+    decoded.clear();
+    decoder(data, params, decoded);
 
-        Detection result;
-        result.class_id = class_ids[idx];
-        result.confidence = confidences[idx];
+    cv::dnn::NMSBoxes(decoded.boxes, decoded.confidences, scoreThreshold, modelNMSThreshold, nmsResult);
 
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<int> dis(100, 255);
-        result.color = cv::Scalar(dis(gen),
-                                  dis(gen),
-                                  dis(gen));
+    detections.clear();
+    for (int idx : nmsResult)
+    {
+        const cv::Rect &box = decoded.boxes[idx];
 
-        result.className = classes[result.class_id];
-        result.box = boxes[idx];
+        CompactDetection result;
+        result.x = box.x;
+        result.y = box.y;
+        result.width = box.width;
+        result.height = box.height;
+        result.classId = decoded.classIds[idx];
+        result.score = decoded.confidences[idx];
 
         detections.push_back(result);
     }
-
-    return detections;
 }
 
 void Inference::loadClassesFromFile()
@@ -159,19 +248,182 @@ void Inference::loadClassesFromFile()
 
 void Inference::loadOnnxNetwork()
 {
-    net = cv::dnn::readNetFromONNX(modelPath);
-    if (cudaEnabled)
+    auto start = std::chrono::steady_clock::now();
+    backend = createBackend(backendOptions, cudaEnabled);
+    backend->loadModel(modelPath);
+
+    // The probe is the model's first forward pass.
+    auto probeStart = std::chrono::steady_clock::now();
+    probeOutputLayout();
+    startupStats.firstForwardMs = msSince(probeStart);
+    startupStats.loadMs = msSince(start);
+}
+
+void Inference::probeOutputLayout()
+{
+    // The output layout is fixed by the model and input size, so probe it with
+    // an empty blob whenever those change and pick the matching decoder
+    // instead of re-checking every frame.
+    const int probeShape[] = {1, 3, (int)modelShape.height, (int)modelShape.width};
+    cv::Mat probe = cv::Mat::zeros(4, probeShape, CV_32F);
+    std::vector<cv::Mat> outputs;
+    backend->forward(probe, outputs);
+
+    int rows = outputs[0].size[1];
+    int dimensions = outputs[0].size[2];
+    if (dimensions > rows) // Check if the shape[2] is more than shape[1] (yolov8)
     {
-        std::cout << "\nRunning on CUDA" << std::endl;
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+        outputLayout = OutputLayout::ChannelMajor;
+        outputRows = dimensions;
+        outputClasses = rows - 4;
     }
     else
     {
-        std::cout << "\nRunning on CPU" << std::endl;
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+        outputLayout = OutputLayout::AnchorMajor;
+        outputRows = rows;
+        outputClasses = dimensions - 5;
+    }
+    decoder = selectDecoder(outputLayout, outputClasses);
+}
+
+void Inference::setInputShape(const cv::Size &shape)
+{
+    if (cv::Size(modelShape) == shape)
+        return;
+
+    // The cascade's models must always agree on the shape: the escalation
+    // model goes first (it restores itself if it throws), and is put back if
+    // the primary then rejects the shape.
+    cv::Size2f previous = modelShape;
+    if (escalation)
+        escalation->setInputShape(shape);
+    modelShape = shape;
+    try
+    {
+        probeOutputLayout();
     }
+    catch (const std::exception &e)
+    {
+        modelShape = previous;
+        probeOutputLayout();
+        if (escalation)
+            escalation->setInputShape(cv::Size(previous));
+        throw std::runtime_error("Model " + modelPath + " does not accept input " + std::to_string(shape.width) + "x" +
+                                 std::to_string(shape.height) + ": " + e.what());
+    }
+}
+
+cv::Size Inference::getInputShape() const
+{
+    return cv::Size(modelShape);
+}
+
+std::string Inference::backendName() const
+{
+    return backend->name();
+}
+
+std::shared_ptr<const ClassTable> Inference::getClassTable() const
+{
+    return classTable;
+}
+
+std::unique_ptr<Inference> Inference::createReplica() const
+{
+    auto replica = std::make_unique<Inference>(modelPath, cv::Size(modelShape), classesPath, cudaEnabled, backendOptions);
+    replica->modelConfidenceThreshold = modelConfidenceThreshold;
+    replica->modelScoreThreshold = modelScoreThreshold;
+    replica->modelNMSThreshold = modelNMSThreshold;
+    replica->letterBoxForSquare = letterBoxForSquare;
+    if (escalation)
+        replica->enableCascade(escalation->modelPath, cascadeOptions);
+    return replica;
+}
+
+double Inference::warmup(const std::vector<cv::Size> &shapes, int batchSize)
+{
+    auto start = std::chrono::steady_clock::now();
+    const cv::Size original = getInputShape();
+    const std::vector<cv::Size> targets = shapes.empty() ? std::vector<cv::Size>{original} : shapes;
+
+    // Warmup frames are neither first detections nor cascade traffic.
+    CascadeStats keptStats = cascadeStats;
+    warmingUp = true;
+
+    for (const cv::Size &shape : targets)
+    {
+        // A noisy 16:9 frame takes the letterboxing, decoding and NMS paths
+        // of a real one.
+        cv::Mat frame(std::max(1, shape.width * 9 / 16), shape.width, CV_8UC3);
+        cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+        try
+        {
+            setInputShape(shape);
+            runInference(frame, compact);
+            if (batchSize > 1)
+            {
+                std::vector<cv::Mat> frames(batchSize, frame);
+                std::vector<std::vector<CompactDetection>> results;
+                runInference(frames, results);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Warning: warmup at " << shape.width << "x" << shape.height << " skipped: " << e.what() << std::endl;
+        }
+    }
+    setInputShape(original);
+
+    warmingUp = false;
+    cascadeStats = keptStats;
+
+    double elapsedMs = msSince(start);
+    startupStats.warmupMs += elapsedMs;
+    return elapsedMs;
+}
+
+StartupStats Inference::getStartupStats() const
+{
+    return startupStats;
+}
+
+void Inference::recordFirstDetection()
+{
+    if (warmingUp || startupStats.timeToFirstDetectionMs >= 0.0)
+        return;
+    startupStats.timeToFirstDetectionMs = msSince(processStart);
+}
+
+void StartupStats::print(std::ostream &out) const
+{
+    out << "Model load " << cv::format("%.1f", loadMs) << " ms (first forward " << cv::format("%.1f", firstForwardMs)
+        << " ms), warmup " << cv::format("%.1f", warmupMs) << " ms, first detection ";
+    if (timeToFirstDetectionMs >= 0.0)
+        out << cv::format("%.1f", timeToFirstDetectionMs) << " ms after start" << std::endl;
+    else
+        out << "none" << std::endl;
+}
+
+void Inference::enableCascade(const std::string &largeModelPath, const CascadeOptions &options)
+{
+    // An explicit weights file belongs to the primary model only.
+    BackendOptions largeOptions = backendOptions;
+    largeOptions.weightsPath.clear();
+
+    escalation = std::make_unique<Inference>(largeModelPath, cv::Size(modelShape.width, modelShape.height),
+                                             classesPath, cudaEnabled, largeOptions);
+    cascadeOptions = options;
+    cascadeStats = CascadeStats{};
+}
+
+bool Inference::cascadeEnabled() const
+{
+    return escalation != nullptr;
+}
+
+CascadeStats Inference::getCascadeStats() const
+{
+    return cascadeStats;
 }
 
 cv::Mat Inference::formatToSquare(const cv::Mat &source)
@@ -5,39 +5,143 @@
 #include <fstream>
 #include <vector>
 #include <string>
-#include <random>
+#include <memory>
 
 // OpenCV / DNN / Inference
 #include <opencv2/imgproc.hpp>
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 
-struct Detection
+#include "backend.h"
+#include "decoder.h"
+#include "detection.h"
+
+// Cascade mode: the primary model runs on every frame and a larger model is
+// only consulted when the primary result is uncertain or interesting.
+struct CascadeOptions
+{
+    // Primary detections scoring in [uncertainLow, uncertainHigh) escalate.
+    float uncertainLow{0.25f};
+    float uncertainHigh{0.60f};
+
+    // Any primary detection of one of these classes escalates.
+    std::vector<int> escalateClasses{};
+};
+
+struct CascadeStats
+{
+    long frames{0};
+    long escalations{0};
+    double primaryMsTotal{0.0};
+    double primaryMsMax{0.0};
+    double escalatedMsTotal{0.0};
+    double escalatedMsMax{0.0};
+
+    double escalationRate() const { return frames ? double(escalations) / frames : 0.0; }
+    double primaryMsMean() const { return frames ? primaryMsTotal / frames : 0.0; }
+    double escalatedMsMean() const { return escalations ? escalatedMsTotal / escalations : 0.0; }
+};
+
+// Cold-start timings of one Inference, in milliseconds.
+struct StartupStats
+{
+    double loadMs{0.0};         // mapping and parsing the model, backend setup
+    double firstForwardMs{0.0}; // the first forward pass (part of loadMs)
+    double warmupMs{0.0};       // all warmup() calls
+    // From process start to the first detection result of a real frame, -1
+    // until there is one. Recorded, not printed: drivers report it.
+    double timeToFirstDetectionMs{-1.0};
+
+    void print(std::ostream &out) const;
+};
+
+// A frame already brought to network geometry by its source, e.g. scaled by
+// the decoder: image is either the model input size, covered the way
+// Inference does it itself (square models: aspect ratio kept, frame top-left
+// on black padding; other models: stretched), or the letterboxed frame at
+// any scale. sourceSize is the original frame size detections are mapped to.
+// A source that builds the network blob itself (see yuvToBlob) sets blob
+// instead of image.
+struct PreparedFrame
 {
-    int class_id{0};
-    std::string className{};
-    float confidence{0.0};
-    cv::Scalar color{};
-    cv::Rect box{};
+    cv::Mat image;
+    cv::Size sourceSize;
+    cv::Mat blob;
 };
 
 class Inference
 {
 public:
-    Inference(const std::string &onnxModelPath, const cv::Size &modelInputShape = {640, 640}, const std::string &classesTxtFile = "", const bool &runWithCuda = true);
+    Inference(const std::string &onnxModelPath, const cv::Size &modelInputShape = {640, 640}, const std::string &classesTxtFile = "", const bool &runWithCuda = true, const BackendOptions &backendOptions = {});
     std::vector<Detection> runInference(const cv::Mat &input);
+    void runInference(const cv::Mat &input, std::vector<CompactDetection> &detections);
+    void runInference(const cv::Mat &input, DetectionBatch &batch);
+
+    // Skips letterboxing, and resizing too when the image is already the
+    // model input size.
+    std::vector<Detection> runInference(const PreparedFrame &frame);
+    void runInference(const PreparedFrame &frame, std::vector<CompactDetection> &detections);
+
+    // Runs the frames through the network as one batch (results[i] belongs to
+    // inputs[i]). Models exported with a fixed batch of 1 throw; with a
+    // cascade enabled the frames are run one at a time.
+    void runInference(const std::vector<cv::Mat> &inputs, std::vector<std::vector<CompactDetection>> &results);
+    void runInference(const std::vector<PreparedFrame> &frames, std::vector<std::vector<CompactDetection>> &results);
+
+    // Changes the network input size at run time. Needs a model exported with
+    // dynamic spatial axes (or a backend that accepts any size); throws and
+    // keeps the previous shape otherwise.
+    void setInputShape(const cv::Size &shape);
+    cv::Size getInputShape() const;
+
+    // Another Inference on the same model, input shape, backend and cascade,
+    // for running in parallel on another thread. The Eigen Tensor backend
+    // shares one immutable copy of the weights between all its engines and
+    // ONNX Runtime shares its pre-packed weights across sessions, so a
+    // replica only adds its activation buffers. OpenCV DNN cannot share a
+    // parsed network: its replicas are full copies.
+    std::unique_ptr<Inference> createReplica() const;
+
+    std::string backendName() const;
+    std::shared_ptr<const ClassTable> getClassTable() const;
+
+    // Runs a synthetic frame through preprocessing, the network and decoding
+    // at each of shapes (the current input shape if empty), batched when
+    // batchSize > 1, so lazy allocations and per-shape kernel selection are
+    // paid before the first real frame. Shapes or batches the model rejects
+    // are skipped with a warning; the input shape is restored afterwards.
+    // Returns the time taken in milliseconds.
+    double warmup(const std::vector<cv::Size> &shapes = {}, int batchSize = 1);
+    StartupStats getStartupStats() const;
+
+    // Loads largeModelPath with the same input shape and backend as this model.
+    void enableCascade(const std::string &largeModelPath, const CascadeOptions &options = {});
+    bool cascadeEnabled() const;
+    CascadeStats getCascadeStats() const;
 
 private:
+    void runModel(const PreparedFrame &frame, std::vector<CompactDetection> &detections, float scoreThreshold);
+    PreparedFrame prepare(const cv::Mat &input);
+    cv::Size coveredSize(const cv::Size &sourceSize) const;
+    void decodeOutput(const float *data, const cv::Size &inputSize, std::vector<CompactDetection> &detections, float scoreThreshold);
+    void runCascade(const PreparedFrame &frame, std::vector<CompactDetection> &detections);
+    bool shouldEscalate(const std::vector<CompactDetection> &detections) const;
+    void recordFirstDetection();
+
     void loadClassesFromFile();
     void loadOnnxNetwork();
+    void probeOutputLayout();
     cv::Mat formatToSquare(const cv::Mat &source);
 
     std::string modelPath{};
     std::string classesPath{};
     bool cudaEnabled{};
+    BackendOptions backendOptions{};
 
     std::vector<std::string> classes{"person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light", "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow", "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee", "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard", "tennis racket", "bottle", "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple", "sandwich", "orange", "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch", "potted plant", "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone", "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear", "hair drier", "toothbrush"};
 
+    std::shared_ptr<const ClassTable> classTable;
+
     cv::Size2f modelShape{};
 
     float modelConfidenceThreshold {0.25};
@@ -46,7 +150,22 @@ private:
 
     bool letterBoxForSquare = true;
 
-    cv::dnn::Net net;
+    std::unique_ptr<InferenceBackend> backend;
+
+    OutputLayout outputLayout{OutputLayout::ChannelMajor};
+    int outputRows{0};
+    int outputClasses{0};
+    DecodeFunction decoder{nullptr};
+    DecodedBoxes decoded;
+    std::vector<int> nmsResult;
+    std::vector<CompactDetection> compact;
+
+    std::unique_ptr<Inference> escalation;
+    CascadeOptions cascadeOptions{};
+    CascadeStats cascadeStats{};
+
+    StartupStats startupStats{};
+    bool warmingUp{false};
 };
 
 #endif // INFERENCE_H
@@ -0,0 +1,194 @@
+#include "jpeg_decoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#ifdef YOLOV8_WITH_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+namespace
+{
+// Reads the EXIF orientation tag from an APP1 segment body.
+int exifOrientation(const uint8_t *segment, size_t length)
+{
+    if (length < 14 || std::string(reinterpret_cast<const char *>(segment), 6) != std::string("Exif\0\0", 6))
+        return 1;
+    const uint8_t *tiff = segment + 6;
+    size_t size = length - 6;
+    bool little = tiff[0] == 'I' && tiff[1] == 'I';
+    if (!little && !(tiff[0] == 'M' && tiff[1] == 'M'))
+        return 1;
+
+    auto read16 = [&](size_t offset) { return little ? tiff[offset] | tiff[offset + 1] << 8 : tiff[offset] << 8 | tiff[offset + 1]; };
+    auto read32 = [&](size_t offset) { return little ? (uint32_t)read16(offset) | (uint32_t)read16(offset + 2) << 16
+                                                     : (uint32_t)read16(offset) << 16 | (uint32_t)read16(offset + 2); };
+
+    size_t directory = read32(4);
+    if (directory + 2 > size)
+        return 1;
+    int entries = read16(directory);
+    for (int i = 0; i < entries; ++i)
+    {
+        size_t entry = directory + 2 + 12 * (size_t)i;
+        if (entry + 12 > size)
+            break;
+        if (read16(entry) == 0x0112)
+        {
+            int orientation = read16(entry + 8);
+            return orientation >= 1 && orientation <= 8 ? orientation : 1;
+        }
+    }
+    return 1;
+}
+
+#ifdef YOLOV8_WITH_TURBOJPEG
+// Turns a decoded image upright, the same way cv::imread does.
+void applyOrientation(cv::Mat &image, int orientation)
+{
+    if (orientation >= 5)
+        cv::transpose(image, image);
+    switch (orientation)
+    {
+    case 2:
+    case 6:
+        cv::flip(image, image, 1);
+        break;
+    case 3:
+    case 7:
+        cv::flip(image, image, -1);
+        break;
+    case 4:
+    case 8:
+        cv::flip(image, image, 0);
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
+cv::Size transposed(const cv::Size &size)
+{
+    return cv::Size(size.height, size.width);
+}
+}
+
+bool readJpegInfo(const std::vector<uint8_t> &data, JpegInfo &info)
+{
+    if (data.size() < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return false;
+
+    info = JpegInfo();
+    size_t position = 2;
+    while (position + 4 <= data.size())
+    {
+        if (data[position] != 0xFF)
+            return false;
+        uint8_t marker = data[position + 1];
+        if (marker == 0xFF)
+        {
+            // Fill byte before the marker.
+            position++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            position += 2;
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9)
+            return false; // scan data before any frame header
+
+        size_t length = data[position + 2] << 8 | data[position + 3];
+        const uint8_t *segment = data.data() + position + 4;
+        if (length < 2 || position + 2 + length > data.size())
+            return false;
+
+        if (marker == 0xE1)
+            info.orientation = exifOrientation(segment, length - 2);
+
+        // SOF0..SOF15 except DHT (C4), JPG (C8) and DAC (CC).
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (length < 7)
+                return false;
+            info.size = cv::Size(segment[3] << 8 | segment[4], segment[1] << 8 | segment[2]);
+            return info.size.area() > 0;
+        }
+        position += 2 + length;
+    }
+    return false;
+}
+
+int jpegScaleDenominator(const cv::Size &size, const cv::Size &minimumSize)
+{
+    for (int denominator : {8, 4, 2})
+    {
+        int width = (size.width + denominator - 1) / denominator;
+        int height = (size.height + denominator - 1) / denominator;
+        if (width >= minimumSize.width && height >= minimumSize.height)
+            return denominator;
+    }
+    return 1;
+}
+
+bool decodeJpeg(const std::vector<uint8_t> &data, const cv::Size &modelSize, bool letterbox, cv::Mat &image, cv::Size &sourceSize)
+{
+    JpegInfo info;
+    if (!readJpegInfo(data, info))
+        return false;
+
+    // The size the picture ends up at in the network input, upright.
+    bool swapped = info.orientation >= 5;
+    sourceSize = swapped ? transposed(info.size) : info.size;
+    cv::Size needed = modelSize;
+    if (letterbox)
+    {
+        double scale = std::min(double(modelSize.width) / sourceSize.width, double(modelSize.height) / sourceSize.height);
+        needed = cv::Size((int)std::lround(sourceSize.width * scale), (int)std::lround(sourceSize.height * scale));
+    }
+    int denominator = jpegScaleDenominator(info.size, swapped ? transposed(needed) : needed);
+
+#ifdef YOLOV8_WITH_TURBOJPEG
+    struct Handle
+    {
+        tjhandle handle{tjInitDecompress()};
+        ~Handle() { tjDestroy(handle); }
+    };
+    thread_local Handle decompressor;
+    if (!decompressor.handle)
+    {
+        image.release();
+        return true;
+    }
+
+    tjscalingfactor factor = {1, denominator};
+    int width = TJSCALED(info.size.width, factor);
+    int height = TJSCALED(info.size.height, factor);
+    image.create(height, width, CV_8UC3);
+    if (tjDecompress2(decompressor.handle, data.data(), (unsigned long)data.size(), image.data,
+                      width, (int)image.step[0], height, TJPF_BGR, 0) != 0)
+    {
+        image.release();
+        return true;
+    }
+    applyOrientation(image, info.orientation);
+#else
+    // OpenCV's libjpeg decoder does the same DCT-domain scaling for these modes.
+    int flags = denominator == 8   ? cv::IMREAD_REDUCED_COLOR_8
+                : denominator == 4 ? cv::IMREAD_REDUCED_COLOR_4
+                : denominator == 2 ? cv::IMREAD_REDUCED_COLOR_2
+                                   : cv::IMREAD_COLOR;
+    try
+    {
+        image = cv::imdecode(data, flags);
+    }
+    catch (const cv::Exception &)
+    {
+        image.release();
+    }
+#endif
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef JPEG_DECODER_H
+#define JPEG_DECODER_H
+
+// Cpp native
+#include <cstdint>
+#include <vector>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// What the JPEG headers say about an image, without decoding it.
+struct JpegInfo
+{
+    cv::Size size{};    // as stored
+    int orientation{1}; // EXIF orientation, 1 (upright) to 8
+};
+
+// Parses the markers up to the frame header. Returns false if data is not a
+// JPEG or is cut short before the frame header.
+bool readJpegInfo(const std::vector<uint8_t> &data, JpegInfo &info);
+
+// Largest DCT scaling denominator (1, 2, 4 or 8) that still gives at least
+// minimumSize from an image of size.
+int jpegScaleDenominator(const cv::Size &size, const cv::Size &minimumSize);
+
+// Decodes a JPEG no larger than needed for a modelSize network: the
+// decompressor scales by 1/2, 1/4 or 1/8 in the DCT domain, so a 12MP photo
+// for a 640 input decodes about 1/16 of the pixels. With letterbox the size
+// needed is the aspect-preserving fit, otherwise modelSize itself. image is
+// BGR and upright (EXIF orientation applied, as cv::imread does); sourceSize
+// is the upright full-resolution size that detections map back to. Uses
+// libjpeg-turbo in builds with YOLOV8_WITH_TURBOJPEG and cv::imdecode's
+// IMREAD_REDUCED_COLOR_* modes elsewhere. Returns false if data is not a
+// JPEG; a JPEG that fails to decode leaves image empty.
+bool decodeJpeg(const std::vector<uint8_t> &data, const cv::Size &modelSize, bool letterbox, cv::Mat &image, cv::Size &sourceSize);
+
+#endif // JPEG_DECODER_H
@@ -0,0 +1,111 @@
+#include "model_file.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path)
+{
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Could not open model file " + path);
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    length = (size_t)fileSize.QuadPart;
+    if (length == 0)
+        return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+        address = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!address)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Could not map model file " + path);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Could not open model file " + path);
+    struct stat status;
+    if (::fstat(fd, &status) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Could not stat model file " + path);
+    }
+    length = (size_t)status.st_size;
+    if (length > 0)
+    {
+        void *mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("Could not map model file " + path);
+        }
+        // The parser reads it front to back, once.
+        ::madvise(mapped, length, MADV_SEQUENTIAL);
+        ::madvise(mapped, length, MADV_WILLNEED);
+        address = static_cast<const char *>(mapped);
+    }
+    // The mapping keeps the file alive.
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (address)
+        UnmapViewOfFile(address);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file && file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+#else
+    if (address)
+        ::munmap(const_cast<char *>(address), length);
+#endif
+}
+
+std::shared_ptr<const MappedFile> mapModelFile(const std::string &path)
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const MappedFile>> mapped;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<const MappedFile> file = mapped[path].lock();
+    if (!file)
+    {
+        file = std::make_shared<const MappedFile>(path);
+        mapped[path] = file;
+    }
+    return file;
+}
+
+std::string modelCachePath(const std::string &directory, const std::string &modelPath, const std::string &suffix)
+{
+    namespace fs = std::filesystem;
+    fs::path model(modelPath);
+    std::string stamp = std::to_string(fs::file_size(model)) + ":" + std::to_string(fs::last_write_time(model).time_since_epoch().count());
+    char key[17];
+    std::snprintf(key, sizeof(key), "%016llx", (unsigned long long)std::hash<std::string>()(stamp));
+    std::string name = model.stem().string() + "-" + key + suffix;
+    return (fs::path(directory) / name).string();
+}
@@ -0,0 +1,43 @@
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+
+// Cpp native
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages come straight from the page
+// cache, so a model file already read by another process (or an earlier run)
+// costs no copy, and several loaders in one process share the same pages.
+class MappedFile
+{
+public:
+    // Throws std::runtime_error if the file cannot be opened or mapped.
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return address; }
+    size_t size() const { return length; }
+
+private:
+    const char *address{nullptr};
+    size_t length{0};
+#ifdef _WIN32
+    void *file{nullptr};
+    void *mapping{nullptr};
+#endif
+};
+
+// Mapping of path, shared with every other holder in the process while any of
+// them keeps it; once released, later loads still find the pages cached.
+std::shared_ptr<const MappedFile> mapModelFile(const std::string &path);
+
+// Name under which an optimised form of modelPath is cached in directory:
+// the model's file name plus a key from its size and modification time, so
+// that a replaced model never picks up a stale entry.
+std::string modelCachePath(const std::string &directory, const std::string &modelPath, const std::string &suffix);
+
+#endif // MODEL_FILE_H
@@ -0,0 +1,195 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#ifdef YOLOV8_WITH_NUMA
+#include <numa.h>
+#endif
+
+namespace
+{
+// Parses a sysfs cpulist such as "0-3,8-11".
+std::vector<int> parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    for (std::string range; std::getline(stream, range, ',');)
+    {
+        if (range.empty() || range == "\n")
+            continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+CpuTopology detectTopology()
+{
+    CpuTopology topology;
+
+#ifdef __linux__
+    // Node ids can have gaps (offline or sparse nodes), so list them all.
+    namespace fs = std::filesystem;
+    std::error_code error;
+    std::vector<int> ids;
+    for (fs::directory_iterator it("/sys/devices/system/node", error), end; !error && it != end; it.increment(error))
+    {
+        std::string name = it->path().filename().string();
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 && name.find_first_not_of("0123456789", 4) == std::string::npos)
+            ids.push_back(std::stoi(name.substr(4)));
+    }
+    std::sort(ids.begin(), ids.end());
+
+    // Only keep CPUs this process may run on (taskset, cgroups).
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool filter = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    for (int id : ids)
+    {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus = parseCpuList(list);
+        if (filter)
+            cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [&allowed](int cpu) { return !CPU_ISSET(cpu, &allowed); }), cpus.end());
+        if (cpus.empty())
+            continue;
+        topology.nodeCpus.push_back(cpus);
+        topology.nodeIds.push_back(id);
+    }
+#elif defined(_WIN32)
+    ULONG highestNode = 0;
+    if (GetNumaHighestNodeNumber(&highestNode))
+    {
+        for (ULONG node = 0; node <= highestNode; ++node)
+        {
+            ULONGLONG mask = 0;
+            if (!GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask) || mask == 0)
+                continue;
+            std::vector<int> cpus;
+            for (int cpu = 0; cpu < 64; ++cpu)
+                if (mask & (ULONGLONG(1) << cpu))
+                    cpus.push_back(cpu);
+            topology.nodeCpus.push_back(cpus);
+            topology.nodeIds.push_back(static_cast<int>(node));
+        }
+    }
+#endif
+
+    if (topology.nodeCpus.empty())
+    {
+        std::vector<int> cpus(std::max(1u, std::thread::hardware_concurrency()));
+        for (size_t i = 0; i < cpus.size(); ++i)
+            cpus[i] = static_cast<int>(i);
+        topology.nodeCpus.push_back(cpus);
+        topology.nodeIds.push_back(0);
+    }
+    return topology;
+}
+}
+
+const CpuTopology &CpuTopology::detect()
+{
+    static const CpuTopology topology = detectTopology();
+    return topology;
+}
+
+int CpuTopology::cpuCount() const
+{
+    int count = 0;
+    for (const std::vector<int> &cpus : nodeCpus)
+        count += static_cast<int>(cpus.size());
+    return count;
+}
+
+int CpuTopology::nodeOfCpu(int cpu) const
+{
+    for (size_t node = 0; node < nodeCpus.size(); ++node)
+        if (std::find(nodeCpus[node].begin(), nodeCpus[node].end(), cpu) != nodeCpus[node].end())
+            return static_cast<int>(node);
+    return -1;
+}
+
+bool pinCurrentThread(int cpu)
+{
+    return pinCurrentThread(std::vector<int>{cpu});
+}
+
+bool pinCurrentThread(const std::vector<int> &cpus)
+{
+    if (cpus.empty())
+        return false;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+        if (cpu < 64)
+            mask |= DWORD_PTR(1) << cpu;
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    return false;
+#endif
+}
+
+bool bindCurrentThreadToNode(int node)
+{
+    const CpuTopology &topology = CpuTopology::detect();
+    if (node < 0 || node >= topology.nodeCount())
+        return false;
+    bool pinned = pinCurrentThread(topology.nodeCpus[node]);
+    preferNodeMemory(node);
+    return pinned;
+}
+
+void preferNodeMemory(int node)
+{
+#ifdef YOLOV8_WITH_NUMA
+    const CpuTopology &topology = CpuTopology::detect();
+    if (node >= 0 && node < topology.nodeCount() && numa_available() >= 0)
+        numa_set_preferred(topology.nodeIds[node]);
+#else
+    (void)node;
+#endif
+}
+
+int currentNumaNode()
+{
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    int node = cpu >= 0 ? CpuTopology::detect().nodeOfCpu(cpu) : -1;
+    return std::max(0, node);
+#else
+    return 0;
+#endif
+}
+
+void firstTouch(void *data, size_t bytes)
+{
+    // Writing one byte per page is enough to fault it in locally.
+    const size_t page = 4096;
+    char *bytePtr = static_cast<char *>(data);
+    for (size_t offset = 0; offset < bytes; offset += page)
+        bytePtr[offset] = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+// Cpp native
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Eigen / ThreadPool
+#include <unsupported/Eigen/CXX11/ThreadPool>
+
+// CPUs grouped by NUMA node. Machines (or builds) without NUMA information are
+// reported as a single node holding every CPU. Only nodes with CPUs this
+// process may run on are listed, so a node argument below is an index into
+// nodeCpus; nodeIds[index] is the kernel's id for that node.
+struct CpuTopology
+{
+    std::vector<std::vector<int>> nodeCpus;
+    std::vector<int> nodeIds;
+
+    static const CpuTopology &detect();
+
+    int nodeCount() const { return static_cast<int>(nodeCpus.size()); }
+    int cpuCount() const;
+    // -1 when the CPU is unknown.
+    int nodeOfCpu(int cpu) const;
+};
+
+// Pin the calling thread; both return false where unsupported or refused.
+bool pinCurrentThread(int cpu);
+bool pinCurrentThread(const std::vector<int> &cpus);
+
+// Pins the calling thread to a node's CPUs and makes the node its preferred
+// memory node. With libnuma (YOLOV8_WITH_NUMA) the preference is explicit;
+// otherwise it relies on the kernel's default first-touch policy, so memory
+// the thread touches first lands on the node it now runs on.
+bool bindCurrentThreadToNode(int node);
+void preferNodeMemory(int node);
+
+// Node (index into CpuTopology::nodeCpus) of the CPU the caller is running
+// on, 0 if unknown.
+int currentNumaNode();
+
+// Touches every page of a fresh buffer from the calling thread so that it is
+// backed by memory local to it under first-touch placement.
+void firstTouch(void *data, size_t bytes);
+
+// Thread environment for Eigen's thread pools that pins worker i to
+// cpus[i % cpus.size()] as it starts, so intra-op pools can be placed too.
+struct PinnedThreadEnvironment : Eigen::StlThreadEnvironment
+{
+    explicit PinnedThreadEnvironment(std::vector<int> cpus = {})
+        : cpus(std::make_shared<std::vector<int>>(std::move(cpus))), nextWorker(std::make_shared<std::atomic<int>>(0)) {}
+
+    EnvThread *CreateThread(std::function<void()> f)
+    {
+        if (cpus->empty())
+            return Eigen::StlThreadEnvironment::CreateThread(std::move(f));
+        int cpu = (*cpus)[(*nextWorker)++ % cpus->size()];
+        return Eigen::StlThreadEnvironment::CreateThread([cpu, f = std::move(f)] {
+            pinCurrentThread(cpu);
+            f();
+        });
+    }
+
+    std::shared_ptr<std::vector<int>> cpus;
+    std::shared_ptr<std::atomic<int>> nextWorker;
+};
+
+typedef Eigen::ThreadPoolTempl<PinnedThreadEnvironment> PinnedThreadPool;
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,103 @@
+#include "yuv_preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+// Two neighbouring samples and the weight of the second.
+struct Tap
+{
+    int first;
+    int second;
+    float weight;
+};
+
+// Pixel-centre aligned source position of destination index i, the way
+// cv::resize (INTER_LINEAR) samples.
+Tap tapAt(int i, float scale, int limit)
+{
+    float position = std::max(0.0f, (i + 0.5f) * scale - 0.5f);
+    Tap tap;
+    tap.first = std::min((int)position, limit - 1);
+    tap.second = std::min(tap.first + 1, limit - 1);
+    tap.weight = std::min(1.0f, position - tap.first);
+    return tap;
+}
+
+inline float sample(const uint8_t *row0, const uint8_t *row1, int stride, const Tap &x, float wy, int offset = 0)
+{
+    float top = row0[x.first * stride + offset] + (row0[x.second * stride + offset] - row0[x.first * stride + offset]) * x.weight;
+    float bottom = row1[x.first * stride + offset] + (row1[x.second * stride + offset] - row1[x.first * stride + offset]) * x.weight;
+    return top + (bottom - top) * wy;
+}
+
+inline float clampUnit(float value)
+{
+    return std::min(255.0f, std::max(0.0f, value)) * (1.0f / 255.0f);
+}
+}
+
+void yuvToBlob(const YuvImage &image, const cv::Size &modelSize, bool letterbox, cv::Mat &blob)
+{
+    CV_Assert(image.width > 0 && image.height > 0 && image.y && image.u && (image.v || image.layout == YuvLayout::NV12));
+
+    const int sizes[] = {1, 3, modelSize.height, modelSize.width};
+    blob.create(4, sizes, CV_32F);
+
+    cv::Size scaled = modelSize;
+    if (letterbox)
+    {
+        double scale = std::min(double(modelSize.width) / image.width, double(modelSize.height) / image.height);
+        scaled.width = std::min(modelSize.width, std::max(1, (int)std::lround(image.width * scale)));
+        scaled.height = std::min(modelSize.height, std::max(1, (int)std::lround(image.height * scale)));
+    }
+
+    const size_t planeSize = (size_t)modelSize.width * modelSize.height;
+    float *planes[] = {blob.ptr<float>(), blob.ptr<float>() + planeSize, blob.ptr<float>() + 2 * planeSize};
+    if (scaled != modelSize)
+        std::fill(planes[0], planes[0] + 3 * planeSize, 0.0f);
+
+    const int chromaWidth = (image.width + 1) / 2;
+    const int chromaHeight = (image.height + 1) / 2;
+    const float scaleX = float(image.width) / scaled.width;
+    const float scaleY = float(image.height) / scaled.height;
+
+    // Column taps are the same for every row.
+    std::vector<Tap> lumaX(scaled.width), chromaX(scaled.width);
+    for (int x = 0; x < scaled.width; ++x)
+    {
+        lumaX[x] = tapAt(x, scaleX, image.width);
+        chromaX[x] = tapAt(x, scaleX * 0.5f, chromaWidth);
+    }
+
+    const bool nv12 = image.layout == YuvLayout::NV12;
+    cv::parallel_for_(cv::Range(0, scaled.height), [&](const cv::Range &rows) {
+        for (int y = rows.start; y < rows.end; ++y)
+        {
+            Tap lumaY = tapAt(y, scaleY, image.height);
+            Tap chromaY = tapAt(y, scaleY * 0.5f, chromaHeight);
+            const uint8_t *y0 = image.y + (size_t)lumaY.first * image.yStride;
+            const uint8_t *y1 = image.y + (size_t)lumaY.second * image.yStride;
+            const uint8_t *u0 = image.u + (size_t)chromaY.first * image.uStride;
+            const uint8_t *u1 = image.u + (size_t)chromaY.second * image.uStride;
+            const uint8_t *v0 = nv12 ? u0 : image.v + (size_t)chromaY.first * image.vStride;
+            const uint8_t *v1 = nv12 ? u1 : image.v + (size_t)chromaY.second * image.vStride;
+
+            float *r = planes[0] + (size_t)y * modelSize.width;
+            float *g = planes[1] + (size_t)y * modelSize.width;
+            float *b = planes[2] + (size_t)y * modelSize.width;
+            for (int x = 0; x < scaled.width; ++x)
+            {
+                float luma = 1.164f * (sample(y0, y1, 1, lumaX[x], lumaY.weight) - 16.0f);
+                float cb = (nv12 ? sample(u0, u1, 2, chromaX[x], chromaY.weight, 0) : sample(u0, u1, 1, chromaX[x], chromaY.weight)) - 128.0f;
+                float cr = (nv12 ? sample(v0, v1, 2, chromaX[x], chromaY.weight, 1) : sample(v0, v1, 1, chromaX[x], chromaY.weight)) - 128.0f;
+
+                r[x] = clampUnit(luma + 1.596f * cr);
+                g[x] = clampUnit(luma - 0.392f * cb - 0.813f * cr);
+                b[x] = clampUnit(luma + 2.017f * cb);
+            }
+        }
+    });
+}
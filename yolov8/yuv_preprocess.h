@@ -0,0 +1,40 @@
+#ifndef YUV_PREPROCESS_H
+#define YUV_PREPROCESS_H
+
+// Cpp native
+#include <cstdint>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+enum class YuvLayout
+{
+    I420, // Y plane, U plane, V plane (yuv420p)
+    NV12  // Y plane, interleaved UV plane
+};
+
+// Planes of a 4:2:0 frame as decoders produce them. The memory belongs to the
+// source (for FFmpegReader: valid until its next read).
+struct YuvImage
+{
+    YuvLayout layout{YuvLayout::I420};
+    int width{0};
+    int height{0};
+    const uint8_t *y{nullptr};
+    int yStride{0};
+    const uint8_t *u{nullptr}; // NV12: the UV plane
+    int uStride{0};
+    const uint8_t *v{nullptr}; // I420 only
+    int vStride{0};
+};
+
+// Turns a YUV frame into the 1x3xHxW float blob of a modelSize network in one
+// pass: bilinear scaling of the luma and chroma planes, BT.601 limited-range
+// conversion to RGB, scaling to [0, 1] and the planar layout. With letterbox
+// the aspect ratio is kept and the picture sits top-left on zeros, which is
+// how Inference letterboxes square models; otherwise it is stretched. The
+// result matches blobFromImage(swapRB=true) on the converted BGR frame, so it
+// can go into a PreparedFrame. Rows run on OpenCV's thread pool.
+void yuvToBlob(const YuvImage &image, const cv::Size &modelSize, bool letterbox, cv::Mat &blob);
+
+#endif // YUV_PREPROCESS_H